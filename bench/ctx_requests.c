@@ -0,0 +1,156 @@
+/* Measures requests per second of a daemon that parses admin commands coming
+ * in over a Unix socket, as NUL-separated arguments in one datagram each. A
+ * forked child stands in for the clients on the other end of a socketpair(2).
+ * "fresh" sets up and frees a spec for every request, "reused" keeps one spec
+ * and one `ls_args_ctx` and resets it in between. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LS_ARGS_IMPLEMENTATION
+#include "ls_args.h"
+
+#define REQUESTS 200000L
+#define OPTIONS 24
+#define MAX_ARGS 32
+
+static const char request[] = "admin\0reload\0--force\0--name\0web-1\0-t\0"
+                              "30\0--opt7\0--opt19\0backend";
+
+struct opts {
+    int force;
+    const char* name;
+    const char* timeout;
+    const char* command;
+    const char* target;
+    int opt[OPTIONS];
+};
+
+static char opt_names[OPTIONS][8];
+
+static int register_spec(ls_args* a, struct opts* o) {
+    int i;
+    int ok = ls_args_bool(a, &o->force, "f", "force", "Don't ask", 0)
+        && ls_args_string(a, &o->name, "n", "name", "Instance name", 0)
+        && ls_args_string(a, &o->timeout, "t", "timeout", "Seconds", 0)
+        && ls_args_pos_string(a, &o->command, "command", LS_ARGS_REQUIRED)
+        && ls_args_pos_string(a, &o->target, "target", 0);
+    for (i = 0; ok && i < OPTIONS; ++i) {
+        ok = ls_args_bool(a, &o->opt[i], NULL, opt_names[i], "Flag", 0);
+    }
+    return ok;
+}
+
+/* Points `argv` at the NUL-terminated arguments in `buf` */
+static int to_argv(char* buf, size_t len, char** argv) {
+    int argc = 0;
+    size_t i = 0;
+    while (i < len && argc < MAX_ARGS) {
+        argv[argc++] = buf + i;
+        i += strlen(buf + i) + 1;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+static void client(int fd) {
+    long i;
+    for (i = 0; i < REQUESTS; ++i) {
+        if (send(fd, request, sizeof(request), 0) < 0) {
+            perror("send");
+            _exit(1);
+        }
+    }
+    /* an empty datagram ends the run */
+    send(fd, request, 0, 0);
+    _exit(0);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run(const char* name, int reuse) {
+    static struct opts layout;
+    struct opts mine;
+    ls_args spec;
+    ls_args_ctx ctx;
+    char buf[512];
+    char* argv[MAX_ARGS + 1];
+    long served = 0;
+    long ok = 0;
+    double start;
+    int fds[2];
+    pid_t pid;
+
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        client(fds[1]);
+    }
+    close(fds[1]);
+
+    if (reuse) {
+        ls_args_init(&spec);
+        if (!register_spec(&spec, &layout)) {
+            exit(1);
+        }
+        ls_args_freeze(&spec);
+        if (!ls_args_ctx_init(&ctx, &spec, &mine, &layout)) {
+            exit(1);
+        }
+    }
+    start = now();
+    for (;;) {
+        ssize_t n = recv(fds[0], buf, sizeof(buf) - 1, 0);
+        int argc;
+        if (n <= 0) {
+            break;
+        }
+        buf[n] = '\0';
+        argc = to_argv(buf, (size_t)n, argv);
+        memset(&mine, 0, sizeof(mine));
+        if (reuse) {
+            ok += ls_args_ctx_parse(&ctx, argc, argv);
+            ls_args_ctx_reset(&ctx);
+        } else {
+            ls_args_init(&spec);
+            if (register_spec(&spec, &mine)) {
+                ok += ls_args_parse(&spec, argc, argv);
+            }
+            ls_args_free(&spec);
+        }
+        served += 1;
+    }
+    printf("  %-7s %9.0f requests/s (%ld of %ld parsed)\n", name,
+        (double)served / (now() - start), ok, served);
+    if (reuse) {
+        ls_args_ctx_free(&ctx);
+        ls_args_free(&spec);
+    }
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+}
+
+int main(void) {
+    int i;
+    for (i = 0; i < OPTIONS; ++i) {
+        sprintf(opt_names[i], "opt%d", i);
+    }
+    printf("%ld requests over a socketpair, %d options:\n", REQUESTS,
+        OPTIONS + 5);
+    run("fresh", 0);
+    run("reused", 1);
+    return 0;
+}
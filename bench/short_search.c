@@ -0,0 +1,99 @@
+/* Compares the ways to find a short option: the search over the packed bytes
+ * used with LS_ARGS_NO_SHORT_TABLE (SIMD if the compiler targets it, see `make
+ * bench`), memchr(3) over the same bytes, the 256-entry table of the default
+ * build, and a loop over the argument records comparing `short_opt[0]`. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LS_ARGS_IMPLEMENTATION
+#define LS_ARGS_NO_SHORT_TABLE
+#include "ls_args.h"
+
+#define LOOKUPS 20000000L
+
+static const char letters[]
+    = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+static size_t search_records(const ls_args* a, unsigned char c) {
+    size_t i;
+    for (i = 0; i < a->args_len; ++i) {
+        const char* opt = a->args[i].short_opt;
+        if (opt != NULL && (unsigned char)opt[0] == c) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static size_t search_memchr(const ls_args* a, unsigned char c) {
+    const unsigned char* p = memchr(a->_shorts, c, a->args_len);
+    return p != NULL ? (size_t)(p - a->_shorts) + 1 : 0;
+}
+
+static size_t search_packed(const ls_args* a, unsigned char c) {
+    return _lsa_short_find(a->_shorts, a->args_len, c);
+}
+
+static size_t table[256];
+
+static size_t search_table(const ls_args* a, unsigned char c) {
+    (void)a;
+    return table[c];
+}
+
+/* Looks up every one of `queries` in turn, LOOKUPS times in total, and prints
+ * the time per lookup. */
+static void run(const char* name,
+    size_t (*search)(const ls_args*, unsigned char), const ls_args* a,
+    const unsigned char* queries, size_t n_queries) {
+    clock_t start;
+    double ns;
+    size_t sum = 0;
+    size_t q = 0;
+    long i;
+    start = clock();
+    for (i = 0; i < LOOKUPS; ++i) {
+        sum += search(a, queries[q]);
+        if (++q == n_queries) {
+            q = 0;
+        }
+    }
+    ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / LOOKUPS;
+    printf("  %-8s %6.2f ns/lookup (checksum %lu)\n", name, ns,
+        (unsigned long)sum);
+}
+
+int main(void) {
+    static const size_t sizes[] = { 4, 16, 32, 62 };
+    static char names[sizeof(letters)][2];
+    static int vals[sizeof(letters)];
+    size_t s;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+        unsigned char queries[sizeof(letters) + 1];
+        ls_args args;
+        size_t n = sizes[s];
+        size_t i;
+
+        ls_args_init(&args);
+        memset(table, 0, sizeof(table));
+        for (i = 0; i < n; ++i) {
+            names[i][0] = letters[i];
+            ls_args_bool(&args, &vals[i], names[i], NULL, "", 0);
+            table[(unsigned char)letters[i]] = i + 1;
+            queries[i] = (unsigned char)letters[i];
+        }
+        /* and one miss */
+        queries[n] = '~';
+
+        printf("%lu short options:\n", (unsigned long)n);
+        run("records", search_records, &args, queries, n + 1);
+        run("memchr", search_memchr, &args, queries, n + 1);
+        run("packed", search_packed, &args, queries, n + 1);
+        run("table", search_table, &args, queries, n + 1);
+        ls_args_free(&args);
+    }
+    return 0;
+}
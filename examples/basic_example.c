@@ -21,7 +21,7 @@ int main(int argc, char** argv) {
         if (help) {
             puts(ls_args_help(&args));
         } else {
-            printf("Error: %s\n", args.last_error);
+            printf("Error: %s\n", ls_args_error(&args));
         }
         ls_args_free(&args);
         return 1;
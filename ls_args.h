@@ -1,7 +1,7 @@
 /* Lion's Standard (LS) ANSI C commandline argument parser with included help
  * renderer.
  *
- * Version: 2.4
+ * Version: 3.0
  * Website: https://libls.org
  * GitHub: https://github.com/libls/args
  * Mirror: https://git.libls.org/args.git
@@ -23,6 +23,7 @@
  * - Long options: `--help`, `--file filename`
  * - Stop signals: `--` (everything after this is positional arguments)
  * - Positional arguments: `input.txt output.txt`
+ * - Variadic positional arguments: `file1.txt file2.txt ...`
  *
  * Includes a help renderer.
  *
@@ -57,7 +58,7 @@
  *         if (help) {
  *             puts(ls_args_help(&args));
  *         } else {
- *             printf("Error: %s\n", args.last_error);
+ *             printf("Error: %s\n", ls_args_error(&args));
  *         }
  *         ls_args_free(&args);
  *         return 1;
@@ -96,7 +97,9 @@
  */
 #pragma once
 
+#include <limits.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifndef LS_REALLOC
 #include <stdlib.h>
@@ -107,6 +110,114 @@
 #define LS_FREE free
 #endif
 
+/* An allocator for one `ls_args`, see `ls_args_set_allocator`. Without one,
+ * LS_REALLOC and LS_FREE are used. */
+typedef struct ls_args_allocator {
+    /* Like realloc(3), with `ptr` NULL for a new block. `old_size` is the size
+     * `ptr` was allocated with. Returns NULL on failure, leaving `ptr` as it
+     * was. */
+    void* (*resize)(void* user, void* ptr, size_t old_size, size_t new_size);
+    /* Frees `ptr`, allocated with `size` bytes. May be NULL if freeing isn't
+     * needed, like for an arena. */
+    void (*release)(void* user, void* ptr, size_t size);
+    void* user;
+} ls_args_allocator;
+
+/* A bump allocator over a caller-provided buffer. Allocations are carved off
+ * the front, only the latest one can grow in place or be given back, and the
+ * whole buffer is released at once, by reusing or discarding it. */
+typedef struct ls_args_arena {
+    char* base;
+    size_t size;
+    size_t used;
+    /* don't use the following fields outside the library */
+    char* _last;
+} ls_args_arena;
+
+/* One piece of text, laid out like the POSIX `struct iovec`. */
+typedef struct ls_args_iovec {
+    const void* base;
+    size_t len;
+} ls_args_iovec;
+
+/* Receives a batch of `count` pieces of text, to be written in order. Returns
+ * 1 on success, 0 on failure. */
+typedef int (*ls_args_sink)(
+    void* user, const ls_args_iovec* iov, size_t count);
+
+typedef enum ls_args_error_code {
+    LS_ARGS_OK = 0,
+    /* the allocator failed */
+    LS_ARGS_ERR_ALLOC = 1,
+    /* malformed argument, like `-` or an empty string */
+    LS_ARGS_ERR_INVALID = 2,
+    /* a `--long` option that was never registered */
+    LS_ARGS_ERR_UNKNOWN_LONG = 3,
+    /* a `-s` short option that was never registered */
+    LS_ARGS_ERR_UNKNOWN_SHORT = 4,
+    /* an option which takes a value wasn't followed by one */
+    LS_ARGS_ERR_MISSING_VALUE = 5,
+    /* more positionals than were registered */
+    LS_ARGS_ERR_UNEXPECTED = 6,
+    /* an LS_ARGS_REQUIRED argument wasn't given */
+    LS_ARGS_ERR_REQUIRED = 7,
+    /* a callback of `ls_args_parse_events` stopped the parse */
+    LS_ARGS_ERR_ABORTED = 8,
+    /* an `@file` couldn't be read, was nested too deeply, or has an
+     * unterminated quote, see `ls_args_ctx_parse_response` */
+    LS_ARGS_ERR_RESPONSE = 9,
+    /* `ls_args_read_positionals` couldn't read, or a positional didn't fit
+     * into the buffer */
+    LS_ARGS_ERR_STREAM = 10,
+    /* the value of a numeric option isn't a number, like `12a` or `0x10` */
+    LS_ARGS_ERR_NUMBER = 11,
+    /* the value of a numeric option doesn't fit into its type */
+    LS_ARGS_ERR_RANGE = 12,
+    /* the spec has more arguments than the function can handle, see
+     * LS_ARGS_ARRAY_MAX and LS_ARGS_VALIDATE_MAX */
+    LS_ARGS_ERR_TOO_MANY = 13
+} ls_args_error_code;
+
+/* Where and why parsing failed. */
+typedef struct ls_args_error_info {
+    ls_args_error_code code;
+    /* index into argv of the token at fault, or -1 if there is none (for
+     * example, when a required argument is missing) */
+    int argv_index;
+    /* index of the involved argument, counted in order of registration, or -1
+     * if there is none */
+    long arg_index;
+
+    /* don't use the following fields outside the library */
+    const char* _token;
+    char _short;
+} ls_args_error_info;
+
+/* Size of the buffer the error message is formatted into, including the NUL
+ * terminator. Longer messages are truncated. At least 128, so the fixed text
+ * of every message fits. */
+#ifndef LS_ARGS_ERROR_MAX
+#define LS_ARGS_ERROR_MAX 256
+#endif
+#if LS_ARGS_ERROR_MAX < 128
+#error "LS_ARGS_ERROR_MAX must be at least 128"
+#endif
+
+/* Most arguments a spec from `ls_args_use_array` can have */
+#ifndef LS_ARGS_ARRAY_MAX
+#define LS_ARGS_ARRAY_MAX 256
+#endif
+
+/* Words of a bitset with one bit per argument */
+#define _lsa_WORD_BITS (sizeof(unsigned long) * CHAR_BIT)
+#define _lsa_WORDS(n) (((n) + _lsa_WORD_BITS - 1) / _lsa_WORD_BITS)
+
+/* Most arguments a spec passed to `ls_args_validate` can have, which keeps
+ * track of them on the stack */
+#ifndef LS_ARGS_VALIDATE_MAX
+#define LS_ARGS_VALIDATE_MAX 4096
+#endif
+
 typedef enum ls_args_mode {
     LS_ARGS_OPTIONAL = 0,
     LS_ARGS_REQUIRED = 1
@@ -114,31 +225,44 @@ typedef enum ls_args_mode {
 
 typedef enum ls_args_type {
     LS_ARGS_TYPE_BOOL = 0,
-    LS_ARGS_TYPE_STRING = 1
+    LS_ARGS_TYPE_STRING = 1,
+    LS_ARGS_TYPE_REST = 2,
+    LS_ARGS_TYPE_INT64 = 3,
+    LS_ARGS_TYPE_UINT64 = 4,
+    LS_ARGS_TYPE_DOUBLE = 5
 } ls_args_type;
 
+/* A view into the `argv` passed to `ls_args_parse`, see `ls_args_pos_rest`. */
+typedef struct ls_args_rest {
+    char** begin;
+    size_t count;
+} ls_args_rest;
+
+/* One argument. Write these with `LS_ARGS_BOOL` and friends rather than by
+ * hand, the layout may change. */
 typedef struct ls_args_arg {
-    int is_pos;
-    union {
-        struct _lsa_spec {
-            const char* short_opt;
-            const char* long_opt;
-        } name;
-        unsigned pos;
-    } match;
-    const char* help;
-    ls_args_type type;
+    /* without dashes, NULL if there is none, and always for positionals */
+    const char* short_opt;
+    const char* long_opt;
     void* val_ptr;
-    ls_args_mode mode;
-    int found;
+    /* an ls_args_type and an ls_args_mode; bytes, so that an argument takes 40
+     * instead of 64 bytes on 64-bit systems */
+    unsigned char type;
+    unsigned char mode;
+    unsigned char is_pos;
+    /* help text, or the name of a positional; only used for messages */
+    const char* help;
 } ls_args_arg;
 
 typedef struct ls_args {
-    /* The last error, if any. Might be dynamically allocated; if so, it's
-     * free'd with `ls_args_free` automatically. Always a valid, printable
-     * string. */
+    /* The last error, if any, as a static description of `error.code`, for
+     * example "Invalid argument". Always a valid, printable string. For the
+     * full message, including the offending argument, use `ls_args_error`. */
     char* last_error;
 
+    /* The last error, if any, in structured form */
+    ls_args_error_info error;
+
     /* don't use the following fields outside the library */
     ls_args_arg* args;
     size_t args_len;
@@ -151,10 +275,63 @@ typedef struct ls_args {
     /* description rendered under the "usage" line in ls_args_help */
     const char* help_description;
 
-    /* some bookkeeping -- these are used to free dynamically allocated memory
-     * for help or errors cleanly on `ls_args_free`. */
-    void* _allocated_error;
+    /* open-addressing hash index over the long option names, built during
+     * registration. Slots hold the hash and length of the name, so that probes
+     * don't have to look at the names, and an index into `args` plus one, 0
+     * marks an empty slot. The capacity is always zero or a power of two. */
+    struct _lsa_slot* _long_index;
+    size_t _long_index_cap;
+    size_t _long_count;
+
+#ifdef LS_ARGS_NO_SHORT_TABLE
+    /* the short option byte of each entry of `args`, 0 if it has none, zero
+     * padded to a multiple of 32 bytes so that the search always compares whole
+     * blocks. Grown together with `args` in `_lsa_add`. */
+    unsigned char* _shorts;
+    size_t _shorts_cap;
+    /* `_shorts` for a spec from `ls_args_use_array` */
+    unsigned char _array_shorts[(LS_ARGS_ARRAY_MAX + 31) / 32 * 32];
+#else
+    /* direct dispatch table for short options, indexed by the option byte.
+     * Entries hold an index into `args` plus one, 0 means no such option. */
+    size_t _short_index[256];
+#endif
+
+    /* indices into `args` of the positionals, in order; `_next_pos` entries */
+    size_t* _pos_index;
+    size_t _pos_cap;
+
+    /* one bit per entry of `args`, set once that argument is seen during
+     * `ls_args_parse`. Grown together with `args` in `_lsa_add`. */
+    unsigned long* _found;
+    size_t _found_words;
+    /* number of LS_ARGS_REQUIRED arguments */
+    size_t _required_count;
+
+    /* set by `ls_args_freeze`, no more arguments can be registered */
+    int _frozen;
+    /* set by `ls_args_compile`, replaces `_long_index` and `_pos_index` */
+    struct _lsa_compiled* _compiled;
+    /* set by `ls_args_use_array` and `ls_args_use_table`: `args` and
+     * `_pos_index` belong to the caller */
+    int _borrowed;
+    /* set by `ls_args_use_table` */
+    const struct ls_args_table* _table;
+    /* the found bits for a spec from `ls_args_use_array`, or from
+     * `ls_args_use_table` if it fits */
+    unsigned long _array_found[_lsa_WORDS(LS_ARGS_ARRAY_MAX)];
+
+    /* the full error message, formatted by `ls_args_error` on first use */
+    char _error_buf[LS_ARGS_ERROR_MAX];
+    int _error_formatted;
+
+    /* some bookkeeping -- this is used to free dynamically allocated memory for
+     * help cleanly on `ls_args_free`. */
     void* _allocated_help;
+    size_t _allocated_help_size;
+
+    /* see `ls_args_set_allocator`, unused if `resize` is NULL */
+    ls_args_allocator _alloc;
 
     size_t _next_pos;
 } ls_args;
@@ -162,6 +339,32 @@ typedef struct ls_args {
 /* Zero-initializes the arguments, does not allocate */
 void ls_args_init(ls_args*);
 
+/* Makes `args` allocate everything through `allocator`, which is copied. Call
+ * it right after `ls_args_init`. Contexts created with `ls_args_ctx_init` use
+ * the allocator of their spec, so it must be thread-safe if they're created
+ * from multiple threads. */
+void ls_args_set_allocator(ls_args* args, const ls_args_allocator* allocator);
+
+/* Prepares `arena` to hand out the `size` bytes at `buffer`, does not
+ * allocate. */
+void ls_args_arena_init(ls_args_arena* arena, void* buffer, size_t size);
+/* Returns an allocator which allocates from `arena`, for example:
+ *
+ *     char buf[16384];
+ *     ls_args_arena arena;
+ *     ls_args_allocator allocator;
+ *     ls_args_arena_init(&arena, buf, sizeof(buf));
+ *     allocator = ls_args_arena_allocator(&arena);
+ *     ls_args_init(&args);
+ *     ls_args_set_allocator(&args, &allocator);
+ *     // the spec, help text and so on all come from `buf` now. When done,
+ *     // just drop `buf`, or reuse it after `ls_args_arena_reset`; calling
+ *     // `ls_args_free` first isn't needed.
+ */
+ls_args_allocator ls_args_arena_allocator(ls_args_arena* arena);
+/* Releases everything allocated from `arena` at once. */
+void ls_args_arena_reset(ls_args_arena* arena);
+
 /* The following functions register arguments. Upon a call to `ls_args_parse`,
  * the given `val` parameter is filled. The `val` pointer must never be NULL.
  *
@@ -187,14 +390,28 @@ void ls_args_init(ls_args*);
 
 /* A "flag", aka a boolean argument. If the argument is present, `*val` is set
  * to 1, otherwise it's left untouched.
- * Can fail if the allocator fails. `args.last_error` is set on failure. */
+ * Can fail if the allocator fails. `args.error` is set on failure. */
 int ls_args_bool(ls_args*, int* val, const char* short_opt,
     const char* long_opt, const char* help, ls_args_mode mode);
 /* An argument which requires a string parameter, for example `--file
- * hello.txt`. Can fail if the allocator fails. `args.last_error` is set on
+ * hello.txt`. Can fail if the allocator fails. `args.error` is set on
  * failure. */
 int ls_args_string(ls_args*, const char** val, const char* short_opt,
     const char* long_opt, const char* help, ls_args_mode mode);
+/* Arguments which require a number, for example `--jobs 8`, converted while
+ * parsing. Integers are decimal, with an optional sign, and doubles are
+ * decimal with an optional fraction and exponent, like `-1.5e3`. There's no
+ * leading whitespace, base prefix, `inf` or `nan`, and the locale doesn't
+ * matter. A value which isn't such a number fails the parse with
+ * LS_ARGS_ERR_NUMBER, one which doesn't fit into the type (or overflows a
+ * double) with LS_ARGS_ERR_RANGE, both at the index of the value. Can fail if
+ * the allocator fails. `args.error` is set on failure. */
+int ls_args_int64(ls_args*, int64_t* val, const char* short_opt,
+    const char* long_opt, const char* help, ls_args_mode mode);
+int ls_args_uint64(ls_args*, uint64_t* val, const char* short_opt,
+    const char* long_opt, const char* help, ls_args_mode mode);
+int ls_args_double(ls_args*, double* val, const char* short_opt,
+    const char* long_opt, const char* help, ls_args_mode mode);
 /* A positional argument
  *
  * ./hello -r hello1 -v -x hello2 --other-flag
@@ -221,58 +438,754 @@ int ls_args_string(ls_args*, const char** val, const char* short_opt,
  */
 int ls_args_pos_string(
     ls_args*, const char** val, const char* name, ls_args_mode mode);
+/* A variadic positional argument, which takes all remaining positionals once
+ * the ones declared with `ls_args_pos_string` are filled.
+ *
+ * ./cat -n a.txt b.txt -v c.txt
+ *          ^^^^^^^^^^^^^^^^^^^^
+ *          val->begin[0..2] = a.txt b.txt c.txt, val->count = 3
+ *
+ * Nothing is copied: `val->begin` points into the `argv` given to
+ * `ls_args_parse`, which is reordered in place so that the positionals are
+ * contiguous. All other entries stay in `argv`, but their order afterwards is
+ * unspecified. Must be declared after all other positionals, and at most once.
+ * If it's LS_ARGS_REQUIRED, at least one value must be given.
+ */
+int ls_args_pos_rest(
+    ls_args*, ls_args_rest* val, const char* name, ls_args_mode mode);
 
 /* Does all the heavy lifting. Assumes that `argv` has `argc` elements. NULL
  * termination of the `argv` array doesn't matter, but null-termination of each
  * individual string is required of course.
  *
  * Returns 1 on success, 0 on failure (boolean behavior).
- * On failure, the `args.last_error` is set to a human-readable string. */
+ * On failure, `args.error` describes what went wrong and where; no memory is
+ * allocated for this. Use `ls_args_error` for a human-readable message. */
 int ls_args_parse(ls_args* args, int argc, char** argv);
 
+/* Returns the human-readable message for the last error, like "Invalid
+ * argument '--foo'", or "Success". The message is formatted on the first call
+ * after an error, into a buffer inside the args, and refers to the `argv` that
+ * was parsed, so that must still be valid. */
+const char* ls_args_error(ls_args*);
+
+/* Freezes the spec like `ls_args_freeze`, and replaces the lookup structures
+ * which were built up during registration with ones that are optimal for the
+ * final set of arguments: a perfect hash for the long options, so that every
+ * lookup, hit or miss, looks at exactly one slot, and the positional index.
+ * Everything is packed into one allocation.
+ *
+ * Optional, but worthwhile if the spec is used to parse many times, or with
+ * many options. Returns 1 on success, 0 if the allocation failed, in which case
+ * the spec is left as it was. */
+int ls_args_compile(ls_args*);
+
+/* Initializers for the entries of a spec given to `ls_args_use_array`, with
+ * the same parameters as the functions of the same name. Names are given
+ * without dashes. */
+#define LS_ARGS_BOOL(val, short_opt, long_opt, help, mode)                     \
+    { short_opt, long_opt, val, LS_ARGS_TYPE_BOOL, mode, 0, help }
+#define LS_ARGS_STRING(val, short_opt, long_opt, help, mode)                   \
+    { short_opt, long_opt, val, LS_ARGS_TYPE_STRING, mode, 0, help }
+#define LS_ARGS_INT64(val, short_opt, long_opt, help, mode)                    \
+    { short_opt, long_opt, val, LS_ARGS_TYPE_INT64, mode, 0, help }
+#define LS_ARGS_UINT64(val, short_opt, long_opt, help, mode)                   \
+    { short_opt, long_opt, val, LS_ARGS_TYPE_UINT64, mode, 0, help }
+#define LS_ARGS_DOUBLE(val, short_opt, long_opt, help, mode)                   \
+    { short_opt, long_opt, val, LS_ARGS_TYPE_DOUBLE, mode, 0, help }
+#define LS_ARGS_POS_STRING(val, name, mode)                                    \
+    { NULL, NULL, val, LS_ARGS_TYPE_STRING, mode, 1, name }
+#define LS_ARGS_POS_REST(val, name, mode)                                      \
+    { NULL, NULL, val, LS_ARGS_TYPE_REST, mode, 1, name }
+
+/* Uses the `len` entries of `args` directly as the spec of the freshly
+ * initialized `a`, instead of registering them one by one. Nothing is copied
+ * or allocated, so `args` can be `static const` and must outlive `a`:
+ *
+ *     static struct { int verbose; const char* in; } opts;
+ *     static const ls_args_arg spec[] = {
+ *         LS_ARGS_BOOL(&opts.verbose, "v", "verbose", "Verbose", 0),
+ *         LS_ARGS_POS_STRING(&opts.in, "input", LS_ARGS_REQUIRED),
+ *     };
+ *     ls_args_use_array(&args, spec, sizeof(spec) / sizeof(*spec));
+ *
+ * The spec behaves as if registered in array order, and is frozen. Lookups
+ * scan the array, which is the right trade for the few dozen options of a
+ * typical program; for thousands, see `ls_args_use_table`. At most
+ * LS_ARGS_ARRAY_MAX entries; with more, this fails with LS_ARGS_ERR_TOO_MANY
+ * and leaves `args` empty. Returns 1 on success, 0 on failure. `ls_args_free`
+ * only frees what was allocated afterwards, like the help text. */
+int ls_args_use_array(ls_args* a, const ls_args_arg* args, size_t len);
+
+/* A complete spec in static storage, usually generated by `tools/ls_args_gen`
+ * from a declarative option table. Nothing is registered when it's used, see
+ * `ls_args_use_table`. */
+typedef struct ls_args_table {
+    /* the arguments, exactly as `ls_args_bool` and friends would have added
+     * them, in the same order */
+    const ls_args_arg* args;
+    size_t args_len;
+    /* indices into `args` of the positionals, in order */
+    const size_t* pos_index;
+    size_t pos_len;
+    /* number of LS_ARGS_REQUIRED arguments */
+    size_t required_count;
+    /* Return the index into `args` plus one of the long option `name` (without
+     * the dashes, `len` bytes) or the short option `c`, and 0 if there's no
+     * such option. Where names repeat, the first one must win. */
+    size_t (*match_long)(const char* name, size_t len);
+    size_t (*match_short)(unsigned char c);
+} ls_args_table;
+
+/* Makes `table` the spec of the freshly initialized `args`, which is frozen
+ * afterwards. The table must outlive `args`, and is never written, so any
+ * number of `ls_args` can use it at once. Each keeps its own record of which
+ * arguments a parse found, inline for up to LS_ARGS_ARRAY_MAX arguments and
+ * allocated otherwise. Parsing, help and `ls_args_ctx` work as usual, and
+ * `ls_args_free` frees only what was allocated since, like the help text.
+ * Returns 1 on success, 0 if the allocation failed. */
+int ls_args_use_table(ls_args* args, const ls_args_table* table);
+
+/* Per-parse state, to parse with one spec from multiple threads at once. See
+ * `ls_args_ctx_init`. */
+typedef struct ls_args_ctx {
+    /* the spec this parses with, read-only */
+    const ls_args* spec;
+    /* same as in `ls_args`, but for parses with this context */
+    char* last_error;
+    ls_args_error_info error;
+    const char* program_name;
+
+    /* don't use the following fields outside the library */
+    char* _values;
+    const char* _layout;
+    /* an argument was found in the current parse if its stamp is `_epoch`,
+     * so starting a parse doesn't have to clear anything */
+    unsigned* _stamps;
+    unsigned _epoch;
+    /* the argv of `ls_args_ctx_parse_buffer`, kept for the next buffer */
+    char** _argv;
+    size_t _argv_cap;
+#ifdef LS_ARGS_POSIX
+    /* the response files of the last `ls_args_ctx_parse_response` */
+    struct _lsa_mapping* _maps;
+    size_t _maps_len;
+    size_t _maps_cap;
+#endif
+    char _error_buf[LS_ARGS_ERROR_MAX];
+    int _error_formatted;
+} ls_args_ctx;
+
+/* Splits the command line `s` into words in place, the way a shell would: at
+ * whitespace, with '...' and "..." grouping and a backslash escaping the next
+ * byte outside of single quotes. Nothing else is expanded, unlike
+ * wordexp(3). Quotes and escapes are removed by moving bytes forward, and
+ * each word is NUL-terminated in `s`. Up to `max` pointers to the words are
+ * stored in `argv`, which isn't NULL-terminated. Returns the number of words,
+ * or -1 if a quote isn't closed or there are more than `max` words. */
+int ls_args_split(char* s, char** argv, int max);
+
+/* Splits `s` with `ls_args_split` into `argv`, which has room for `max`
+ * words, and parses them with `ls_args_parse`. The first word is the program
+ * name. Values point into `s`, and nothing is allocated. An unclosed quote
+ * fails with LS_ARGS_ERR_INVALID, and too many words with
+ * LS_ARGS_ERR_UNEXPECTED, at the index of the word at fault. */
+int ls_args_parse_string(ls_args* args, char* s, char** argv, int max);
+
+/* Marks the spec as complete. Registering more arguments afterwards is a
+ * programming error. A frozen spec is never modified by `ls_args_ctx_*`
+ * functions, so any number of threads may use it at once, each with its own
+ * `ls_args_ctx`. `ls_args_parse` and `ls_args_help` still modify the spec, so
+ * don't call them while other threads use it. */
+void ls_args_freeze(ls_args*);
+
+/* Prepares `ctx` for parsing with the frozen `spec`. Allocates once, so that
+ * parsing with the context doesn't.
+ *
+ * With `values` and `layout` both NULL, values are written through the `val`
+ * pointers given at registration, just like `ls_args_parse` does. Otherwise,
+ * the `val` pointers must all point into the object `layout`, and values are
+ * written to the same offsets in the object `values`, which must be of the same
+ * type. This gives every thread its own storage:
+ *
+ *     struct opts { int verbose; const char* out; } layout, mine = defaults;
+ *     ls_args_bool(&spec, &layout.verbose, "v", "verbose", "Verbose", 0);
+ *     ls_args_string(&spec, &layout.out, "o", "out", "Output file", 0);
+ *     ls_args_freeze(&spec);
+ *     // in each thread:
+ *     ls_args_ctx_init(&ctx, &spec, &mine, &layout);
+ *     ls_args_ctx_parse(&ctx, argc, argv); // fills `mine`
+ *
+ * Returns 1 on success, 0 if the allocation failed. Free with
+ * `ls_args_ctx_free` in either case. */
+int ls_args_ctx_init(
+    ls_args_ctx* ctx, const ls_args* spec, void* values, const void* layout);
+/* Like `ls_args_parse`, with the results stored in the context. Starting a
+ * parse takes constant time no matter how many arguments the spec has, and
+ * doesn't allocate, so one context can serve any number of requests. */
+int ls_args_ctx_parse(ls_args_ctx* ctx, int argc, char** argv);
+/* Forgets the last parse: the error, the program name and which arguments
+ * were found. Takes constant time and keeps every buffer of the context. The
+ * values belong to the caller, who resets those. */
+void ls_args_ctx_reset(ls_args_ctx* ctx);
+/* Like `ls_args_ctx_parse`, for the `len` bytes of `buf`, which hold the
+ * arguments one after the other, each terminated by a NUL byte, like
+ * /proc/PID/cmdline does. The first one is the program name. Values point into
+ * `buf`, which isn't copied or written, and rest arguments are views into an
+ * argv the context keeps until the next parse or `ls_args_ctx_free`. That argv
+ * only grows when a buffer has more arguments than every one before, so
+ * parsing many buffers with one context doesn't allocate after the first few.
+ * Fails with LS_ARGS_ERR_INVALID if the last argument isn't terminated, and
+ * with LS_ARGS_ERR_ALLOC if the argv couldn't grow. */
+int ls_args_ctx_parse_buffer(ls_args_ctx* ctx, char* buf, size_t len);
+#ifdef LS_ARGS_POSIX
+/* Most levels of `@file` inside of `@file`, see `ls_args_ctx_parse_response`.
+ * Also what stops a file which names itself. */
+#ifndef LS_ARGS_RESPONSE_DEPTH
+#define LS_ARGS_RESPONSE_DEPTH 8
+#endif
+
+/* Flags for `ls_args_ctx_parse_response` */
+enum {
+    /* arguments in the file are separated by NUL bytes, like the output of
+     * `find -print0`, instead of by whitespace */
+    LS_ARGS_RESPONSE_NUL = 1,
+    /* with whitespace separation, '...' and "..." group, and a backslash
+     * escapes the next byte outside of single quotes */
+    LS_ARGS_RESPONSE_QUOTES = 2
+};
+
+/* Like `ls_args_ctx_parse`, but every argument after the program name of the
+ * form `@path` is replaced by the arguments in the file `path`, which may name
+ * more files, up to LS_ARGS_RESPONSE_DEPTH levels deep. This gets around the
+ * ARG_MAX limit on the command line. `flags` is a combination of the
+ * LS_ARGS_RESPONSE_* flags. Only available with LS_ARGS_POSIX defined.
+ *
+ * The files are mapped with mmap(2) and split in place, in a private mapping,
+ * so values point into the mappings and nothing is copied onto the heap but
+ * the argument pointers. The mappings, and so the values, stay valid until the
+ * next call of this function or `ls_args_ctx_free`. Error indices count in the
+ * expanded arguments. A file which can't be read fails with
+ * LS_ARGS_ERR_RESPONSE and errno as left by open(2), fstat(2) or mmap(2), and
+ * with errno ELOOP if nested too deeply or EINVAL for an unterminated quote.
+ * Only regular files can be mapped, so pipes and devices, like `@/dev/stdin`,
+ * fail with errno EINVAL too. */
+int ls_args_ctx_parse_response(
+    ls_args_ctx* ctx, int argc, char** argv, int flags);
+#endif
+/* Like `ls_args_error`, for the last parse with this context. */
+const char* ls_args_ctx_error(ls_args_ctx* ctx);
+void ls_args_ctx_free(ls_args_ctx* ctx);
+
+/* What `ls_args_next` found */
+typedef enum ls_args_item {
+    /* all of argv was seen */
+    LS_ARGS_ITEM_END = 0,
+    /* the iterator's `error` says what went wrong */
+    LS_ARGS_ITEM_ERROR = 1,
+    LS_ARGS_ITEM_OPTION = 2,
+    LS_ARGS_ITEM_POSITIONAL = 3
+} ls_args_item;
+
+/* A getopt-like walk over argv, one option or positional at a time. See
+ * `ls_args_iter_init`. */
+typedef struct ls_args_iter {
+    /* the spec this iterates with, read-only */
+    const ls_args* spec;
+    /* Set by every `ls_args_next`: the argument that matched, and its index in
+     * order of registration, like `error.arg_index`. NULL and -1 unless an
+     * option or positional was found. */
+    const ls_args_arg* arg;
+    long arg_index;
+    /* the value given to a string option, the positional itself, or NULL */
+    const char* value;
+    /* index into argv of the option or positional */
+    int argv_index;
+    /* what went wrong, after LS_ARGS_ITEM_ERROR */
+    ls_args_error_info error;
+
+    /* don't use the following fields outside the library */
+    int _argc;
+    char** _argv;
+    /* the next argv index to look at */
+    int _next;
+    /* the rest of a short option cluster like `-abc`, or NULL */
+    const char* _cluster;
+    size_t _pos;
+    int _stopped;
+    int _failed;
+    char _error_buf[LS_ARGS_ERROR_MAX];
+    int _error_formatted;
+} ls_args_iter;
+
+/* Prepares `it` to walk `argv` with `spec`. Nothing is allocated, and neither
+ * the spec, the values nor argv are written while iterating; values are
+ * handed out instead:
+ *
+ *     ls_args_iter_init(&it, &spec, argc, argv);
+ *     while ((item = ls_args_next(&it)) == LS_ARGS_ITEM_OPTION
+ *         || item == LS_ARGS_ITEM_POSITIONAL) {
+ *         if (it.arg->val_ptr == &help)
+ *             break; // the rest of argv is never looked at
+ *         ...
+ *     }
+ *
+ * Options and positionals are matched exactly like `ls_args_parse` does, and
+ * yield the same errors, except that required arguments aren't checked since
+ * the walk may stop at any point. */
+void ls_args_iter_init(
+    ls_args_iter* it, const ls_args* spec, int argc, char** argv);
+/* Advances to the next option or positional. After LS_ARGS_ITEM_END or
+ * LS_ARGS_ITEM_ERROR, it keeps returning the same. */
+ls_args_item ls_args_next(ls_args_iter* it);
+/* Like `ls_args_error`, for the error of the iterator. */
+const char* ls_args_iter_error(ls_args_iter* it);
+
+/* Callbacks for `ls_args_parse_events`, any of which may be NULL. The ones
+ * returning int return 0 to abort the parse, which then fails with
+ * LS_ARGS_ERR_ABORTED, or nonzero to go on. `arg_index` counts in order of
+ * registration, like `error.arg_index`. */
+typedef struct ls_args_events {
+    void* user;
+    /* the option `arg` was given in `argv[argv_index]` */
+    int (*option)(
+        void* user, const ls_args_arg* arg, long arg_index, int argv_index);
+    /* `argv[argv_index]` is the value of the option `arg`, which was just
+     * reported to `option`. Values of numeric options are known to convert. */
+    int (*value)(void* user, const ls_args_arg* arg, long arg_index,
+        const char* value, int argv_index);
+    /* `argv[argv_index]` is a positional, which belongs to the positional or
+     * rest argument `arg` */
+    int (*positional)(void* user, const ls_args_arg* arg, long arg_index,
+        const char* value, int argv_index);
+    /* the parse failed with `error`, for any reason but an abort */
+    void (*error)(void* user, const ls_args_error_info* error);
+} ls_args_events;
+
+/* Like `ls_args_parse`, but instead of writing values through the `val`
+ * pointers, hands every option, value and positional to `events` as the loop
+ * reaches it. argv isn't reordered for rest arguments, and nothing is
+ * allocated, so memory use doesn't grow with argc. Required arguments are
+ * still checked at the end. Returns 1 on success and 0 on failure, with the
+ * error in `args` as usual. */
+int ls_args_parse_events(
+    ls_args* args, int argc, char** argv, const ls_args_events* events);
+/* Like `ls_args_parse_events`, with the error stored in the context. */
+int ls_args_ctx_parse_events(ls_args_ctx* ctx, int argc, char** argv,
+    const ls_args_events* events);
+
+/* Checks whether `argv` would parse with the frozen `spec`, without parsing
+ * it: no value is written, argv isn't reordered and nothing is allocated, so
+ * any number of threads can validate against the same spec. Returns 1 if the
+ * command line is valid, otherwise 0 with the error in `error`. A spec with
+ * more than LS_ARGS_VALIDATE_MAX arguments fails with LS_ARGS_ERR_TOO_MANY. */
+int ls_args_validate(
+    const ls_args* spec, int argc, char** argv, ls_args_error_info* error);
+/* Formats `error`, as returned for `spec`, into `buf` like `ls_args_error`
+ * does. */
+void ls_args_format_error(const ls_args* spec, const ls_args_error_info* error,
+    char buf[LS_ARGS_ERROR_MAX]);
+
+#ifdef LS_ARGS_PTHREAD
+/* One command line for `ls_args_parse_batch`: either `argc` and `argv`, or, if
+ * `argv` is NULL, the `record_len` bytes at `record`, which hold the arguments
+ * each terminated by a NUL byte, like for `ls_args_ctx_parse_buffer`. */
+typedef struct ls_args_batch_input {
+    int argc;
+    char** argv;
+    char* record;
+    size_t record_len;
+} ls_args_batch_input;
+
+/* How one command line of `ls_args_parse_batch` parsed */
+typedef struct ls_args_batch_result {
+    /* 1 if it parsed, 0 if not */
+    unsigned char ok;
+    /* an ls_args_error_code */
+    unsigned char code;
+    /* like in `ls_args_error_info` */
+    int argv_index;
+    long arg_index;
+} ls_args_batch_result;
+
+/* Records taken by a worker of `ls_args_parse_batch` at once */
+#ifndef LS_ARGS_BATCH_CHUNK
+#define LS_ARGS_BATCH_CHUNK 64
+#endif
+
+/* Parses the `count` command lines of `inputs` with the frozen `spec` on
+ * `threads` threads, or one per online processor if `threads` is 0 or less,
+ * and stores how each went in `results`. Each thread starts with an equal
+ * share and takes LS_ARGS_BATCH_CHUNK of it at a time, and one that runs out
+ * steals half of what's left to another, so uneven inputs stay balanced. The
+ * calling thread is one of them.
+ *
+ * Values aren't written, and the inputs aren't modified. Instead, if `bound`
+ * isn't NULL, it gets `spec->args_len` ints per input, one per argument, in
+ * order of registration: the argv index of the last time a boolean was given,
+ * of the last value of a string option, of a positional, or of the first
+ * value of a rest argument, and -1 if the argument wasn't given.
+ *
+ * Allocates with the allocator of `spec`, which must be thread-safe: up front
+ * for the threads, and again whenever a thread meets a `record` with more
+ * arguments than it has room for. Returns 1 on success, and 0 if setting up
+ * the threads failed. A failure later on only fails that record, with
+ * LS_ARGS_ERR_ALLOC in its result. */
+int ls_args_parse_batch(const ls_args* spec, const ls_args_batch_input* inputs,
+    size_t count, ls_args_batch_result* results, int* bound, int threads);
+#endif
+
+#ifdef LS_ARGS_POSIX
+/* Flags for `ls_args_read_positionals` */
+enum {
+    /* positionals are separated by NUL bytes, like the output of
+     * `find -print0`, instead of by newlines */
+    LS_ARGS_STREAM_NUL = 1
+};
+
+/* Reads more positionals from `fd` until end of file, for pipelines like
+ * `find -print0 | tool --stdin -0`, usually after `ls_args_parse` handled
+ * the options in argv. Each one is handed to the `positional` callback of
+ * `events` as a value of the rest argument, with an `argv_index` of -1, and
+ * a callback may abort like in `ls_args_parse_events`. Without a rest
+ * argument, the first one fails with LS_ARGS_ERR_UNEXPECTED. Empty ones are
+ * skipped, and the last one needn't be terminated.
+ *
+ * `fd` is read in chunks into the `size` bytes at `buf`, which is all the
+ * memory used, no matter how many positionals arrive. The value handed to the
+ * callback points into `buf`, so copy what you keep. A positional of `size`
+ * bytes or more fails with LS_ARGS_ERR_STREAM and errno ENOBUFS, and a failed
+ * read(2) with LS_ARGS_ERR_STREAM and errno as it left it. `flags` is 0 or
+ * LS_ARGS_STREAM_NUL. Only available with LS_ARGS_POSIX defined. Returns 1 on
+ * success, 0 on failure, with the error in `args`. */
+int ls_args_read_positionals(ls_args* args, int fd, char* buf, size_t size,
+    int flags, const ls_args_events* events);
+#endif
+
 /* Constructs a help message from the arguments registered on the args struct
  * via `ls_args_{bool, string, ...} functions.
- * The string is dynamically allocated using LS_REALLOC and is freed
- * automatically once ls_args_free() is called. The string may be
- * replaced/changed by the next invocation to this function, as the buffer is
- * reused. */
+ * The string is dynamically allocated with the allocator of the args (by
+ * default LS_REALLOC) and is freed automatically once ls_args_free() is called.
+ * The string may be replaced/changed by the next invocation to this function,
+ * as the buffer is reused. */
 char* ls_args_help(ls_args*);
 
+/* Renders the same help text as `ls_args_help`, but hands it to `sink` in
+ * batches of pieces instead of building a string. The pieces point at the
+ * strings you registered and at string literals, nothing is allocated or
+ * copied. Returns 1 on success, 0 if the sink failed. */
+int ls_args_help_stream(ls_args*, ls_args_sink sink, void* user);
+
+#ifdef LS_ARGS_POSIX
+/* Like `ls_args_help_stream`, but writes to the file descriptor `fd` with
+ * writev(2). Only available with LS_ARGS_POSIX defined. Returns 1 on success,
+ * 0 on a write error (errno is left as set by writev). */
+int ls_args_help_fd(ls_args*, int fd);
+#endif
+
 /* Frees all memory allocated in the args. */
 void ls_args_free(ls_args*);
 
 /* Define this in exactly ONE source file, or in an object file compiled
- * separately with -DLS_ARGS_IMPLEMENTATION. */
+ * separately with -DLS_ARGS_IMPLEMENTATION.
+ *
+ * Additionally define LS_ARGS_POSIX (everywhere you include this file) to get
+ * the parts which need a POSIX system, like `ls_args_help_fd`.
+ *
+ * Define LS_ARGS_NO_SHORT_TABLE (everywhere you include this file) to drop the
+ * 256-entry short option table from `ls_args`, which is 2 KiB on 64-bit
+ * systems. Short options are then kept as one byte per argument and searched
+ * 16 or 32 at a time with SSE2, AVX2 or NEON, whichever the compiler targets,
+ * or with memchr(3) otherwise. Define LS_ARGS_NO_SIMD to always use memchr.
+ *
+ * Define LS_ARGS_PTHREAD (everywhere you include this file) to get
+ * `ls_args_parse_batch`, which needs POSIX threads, so link with -pthread. */
 #ifdef LS_ARGS_IMPLEMENTATION
 
 #define _lsa_ALLOC_FAIL_STR "Allocation failure"
 
 #include <assert.h>
+#include <limits.h>
+#include <math.h> /* for HUGE_VAL */
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h> /* for sprintf */
 #include <string.h>
 
-static int _lsa_set_error_va(
-    ls_args* a, size_t len, const char* fmt, va_list ap) {
-    a->_allocated_error = LS_REALLOC(a->_allocated_error, len);
-    if (a->_allocated_error == NULL) {
-        a->last_error = _lsa_ALLOC_FAIL_STR;
-        return 0;
+#ifdef LS_ARGS_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef LS_ARGS_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(LS_ARGS_NO_SHORT_TABLE) && !defined(LS_ARGS_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define _lsa_SHORT_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)                                     \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define _lsa_SHORT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define _lsa_SHORT_NEON
+#endif
+#endif
+
+/* Number of pieces handed to a sink at once */
+#ifndef LS_ARGS_IOV_BATCH
+#define LS_ARGS_IOV_BATCH 64
+#endif
+
+static const char* _lsa_error_summary(ls_args_error_code code) {
+    switch (code) {
+    case LS_ARGS_OK:
+        return "Success";
+    case LS_ARGS_ERR_ALLOC:
+        return _lsa_ALLOC_FAIL_STR;
+    case LS_ARGS_ERR_INVALID:
+    case LS_ARGS_ERR_UNKNOWN_LONG:
+    case LS_ARGS_ERR_UNKNOWN_SHORT:
+        return "Invalid argument";
+    case LS_ARGS_ERR_MISSING_VALUE:
+        return "Expected argument";
+    case LS_ARGS_ERR_UNEXPECTED:
+        return "Unexpected argument";
+    case LS_ARGS_ERR_REQUIRED:
+        return "Required argument not provided";
+    case LS_ARGS_ERR_ABORTED:
+        return "Parsing aborted";
+    case LS_ARGS_ERR_RESPONSE:
+        return "Invalid response file";
+    case LS_ARGS_ERR_STREAM:
+        return "Reading positional arguments failed";
+    case LS_ARGS_ERR_NUMBER:
+        return "Invalid number";
+    case LS_ARGS_ERR_RANGE:
+        return "Number out of range";
+    case LS_ARGS_ERR_TOO_MANY:
+        return "Too many arguments in the spec";
     }
-    memset(a->_allocated_error, 0, len);
-    vsprintf(a->_allocated_error, fmt, ap);
-    a->last_error = a->_allocated_error;
-    return 1;
+    return "Unknown error";
 }
 
-static int _lsa_set_error(ls_args* a, size_t len, const char* fmt, ...) {
-    int ret;
-    va_list ap;
-    va_start(ap, fmt);
-    ret = _lsa_set_error_va(a, len, fmt, ap);
-    va_end(ap);
-    return ret;
+/* Records an error without formatting anything. Always returns 0, so it can be
+ * returned directly. */
+static int _lsa_fail(ls_args_error_info* err, ls_args_error_code code,
+    int argv_index, long arg_index, const char* token, char short_opt) {
+    err->code = code;
+    err->argv_index = argv_index;
+    err->arg_index = arg_index;
+    err->_token = token;
+    err->_short = short_opt;
+    return 0;
+}
+
+static void _lsa_set_error_code(ls_args* a, ls_args_error_code code) {
+    _lsa_fail(&a->error, code, -1, -1, NULL, 0);
+    a->last_error = (char*)_lsa_error_summary(code);
+    a->_error_formatted = 0;
+}
+
+/* Longest part of a user-provided string that goes into an error message. With
+ * at most one such string per message, this keeps every message within
+ * LS_ARGS_ERROR_MAX. */
+#define _lsa_ERROR_TOKEN_MAX ((int)LS_ARGS_ERROR_MAX - 96)
+
+/* Prints the name of an option as `--long`, or `-s` if it has no long name. */
+static void _lsa_format_option(char* buf, const ls_args_arg* arg) {
+    if (arg->long_opt != NULL) {
+        sprintf(buf, "--%.*s", _lsa_ERROR_TOKEN_MAX, arg->long_opt);
+    } else {
+        sprintf(buf, "-%.1s", arg->short_opt);
+    }
+}
+
+/* How much of a token still fits into a message which already holds the
+ * option `name` and the text `fixed`, including its NUL terminator. For the
+ * messages that name both. */
+static int _lsa_token_room(const char* name, size_t fixed) {
+    size_t used = strlen(name) + fixed;
+    return used < LS_ARGS_ERROR_MAX ? (int)(LS_ARGS_ERROR_MAX - used) : 0;
+}
+
+static void _lsa_format_error(
+    const ls_args* a, const ls_args_error_info* err, char* buf) {
+    const ls_args_arg* arg = err->arg_index >= 0 ? &a->args[err->arg_index]
+                                                 : NULL;
+    char name[_lsa_ERROR_TOKEN_MAX + 4];
+    switch (err->code) {
+    case LS_ARGS_ERR_INVALID:
+        sprintf(buf, "Invalid argument '%.*s'", _lsa_ERROR_TOKEN_MAX,
+            err->_token);
+        break;
+    case LS_ARGS_ERR_UNKNOWN_LONG:
+        sprintf(buf, "Invalid argument '--%.*s'", _lsa_ERROR_TOKEN_MAX,
+            err->_token);
+        break;
+    case LS_ARGS_ERR_UNKNOWN_SHORT:
+        sprintf(buf, "Invalid argument '-%c'", err->_short);
+        break;
+    case LS_ARGS_ERR_MISSING_VALUE:
+        if (err->_short != 0) {
+            /* in a group of short options, like `-fh` */
+            sprintf(buf,
+                "Expected argument following '-%.1s', instead got another "
+                "argument '-%c'",
+                arg->short_opt, err->_short);
+        } else {
+            _lsa_format_option(name, arg);
+            sprintf(buf, "Expected argument following '%s'", name);
+        }
+        break;
+    case LS_ARGS_ERR_UNEXPECTED:
+        sprintf(buf, "Unexpected argument '%.*s'", _lsa_ERROR_TOKEN_MAX,
+            err->_token);
+        break;
+    case LS_ARGS_ERR_RESPONSE:
+        sprintf(buf, "Invalid response file '%.*s'", _lsa_ERROR_TOKEN_MAX,
+            err->_token);
+        break;
+    /* the value gets what the option leaves */
+    case LS_ARGS_ERR_NUMBER:
+        _lsa_format_option(name, arg);
+        sprintf(buf, "Invalid number '%.*s' for '%s'",
+            _lsa_token_room(name, sizeof("Invalid number '' for ''")),
+            err->_token, name);
+        break;
+    case LS_ARGS_ERR_RANGE:
+        _lsa_format_option(name, arg);
+        sprintf(buf, "Number '%.*s' out of range for '%s'",
+            _lsa_token_room(name, sizeof("Number '' out of range for ''")),
+            err->_token, name);
+        break;
+    case LS_ARGS_ERR_REQUIRED:
+        if (arg->is_pos) {
+            sprintf(buf, "Required argument '%.*s' not provided",
+                _lsa_ERROR_TOKEN_MAX, arg->help);
+        } else {
+            _lsa_format_option(name, arg);
+            sprintf(buf, "Required argument '%s' not found", name);
+        }
+        break;
+    default:
+        strcpy(buf, _lsa_error_summary(err->code));
+        break;
+    }
+}
+
+const char* ls_args_error(ls_args* a) {
+    if (!a->_error_formatted) {
+        _lsa_format_error(a, &a->error, a->_error_buf);
+        a->_error_formatted = 1;
+    }
+    return a->_error_buf;
+}
+
+/* Every allocation goes through these two, with the allocator of `a` */
+static void* _lsa_realloc(
+    const ls_args* a, void* p, size_t old_size, size_t new_size) {
+    if (a->_alloc.resize != NULL) {
+        return a->_alloc.resize(a->_alloc.user, p, old_size, new_size);
+    }
+    return LS_REALLOC(p, new_size);
+}
+
+static void _lsa_free(const ls_args* a, void* p, size_t size) {
+    if (p == NULL) {
+        return;
+    }
+    if (a->_alloc.resize != NULL) {
+        if (a->_alloc.release != NULL) {
+            a->_alloc.release(a->_alloc.user, p, size);
+        }
+        return;
+    }
+    LS_FREE(p);
+}
+
+/* Alignment of everything the arena hands out, enough for any of the
+ * library's types */
+typedef union _lsa_max_align {
+    long l;
+    double d;
+    void* p;
+    size_t s;
+} _lsa_max_align;
+struct _lsa_align_probe {
+    char c;
+    _lsa_max_align u;
+};
+#define _lsa_ALIGN (offsetof(struct _lsa_align_probe, u))
+
+void ls_args_arena_init(ls_args_arena* arena, void* buffer, size_t size) {
+    size_t skip = (_lsa_ALIGN - (size_t)((uintptr_t)buffer % _lsa_ALIGN))
+        % _lsa_ALIGN;
+    assert(arena != NULL);
+    if (skip > size) {
+        skip = size;
+    }
+    arena->base = (char*)buffer + skip;
+    arena->size = size - skip;
+    arena->used = 0;
+    arena->_last = NULL;
+}
+
+void ls_args_arena_reset(ls_args_arena* arena) {
+    arena->used = 0;
+    arena->_last = NULL;
+}
+
+static void* _lsa_arena_resize(
+    void* user, void* p, size_t old_size, size_t new_size) {
+    ls_args_arena* arena = (ls_args_arena*)user;
+    size_t start;
+    if (p != NULL && p == arena->_last) {
+        /* the latest allocation grows or shrinks in place */
+        start = (size_t)((char*)p - arena->base);
+        if (new_size > arena->size - start) {
+            return NULL;
+        }
+        arena->used = start + new_size;
+        return p;
+    }
+    start = (arena->used + _lsa_ALIGN - 1) / _lsa_ALIGN * _lsa_ALIGN;
+    if (start > arena->size || new_size > arena->size - start) {
+        return NULL;
+    }
+    if (p != NULL) {
+        memcpy(arena->base + start, p, old_size < new_size ? old_size
+                                                           : new_size);
+    }
+    arena->_last = arena->base + start;
+    arena->used = start + new_size;
+    return arena->_last;
+}
+
+static void _lsa_arena_release(void* user, void* p, size_t size) {
+    ls_args_arena* arena = (ls_args_arena*)user;
+    (void)size;
+    if (p == arena->_last) {
+        /* older allocations are only released by a reset */
+        arena->used = (size_t)((char*)p - arena->base);
+        arena->_last = NULL;
+    }
+}
+
+ls_args_allocator ls_args_arena_allocator(ls_args_arena* arena) {
+    ls_args_allocator allocator;
+    allocator.resize = _lsa_arena_resize;
+    allocator.release = _lsa_arena_release;
+    allocator.user = arena;
+    return allocator;
 }
 
 /* 0 on failure, 1 on success */
@@ -288,21 +1201,210 @@ static int _lsa_add(ls_args* a, ls_args_arg** arg) {
             /* would overflow size_t */
             return 0;
         }
-        new_args = LS_REALLOC(a->args, new_cap * sizeof(*new_args));
+        new_args = _lsa_realloc(a, a->args, a->args_cap * sizeof(*new_args),
+            new_cap * sizeof(*new_args));
         if (new_args == NULL) {
             /* allocation failure */
             return 0;
         }
-        a->args_cap = new_cap;
         a->args = new_args;
+        a->args_cap = new_cap;
     }
+    if (_lsa_WORDS(a->args_len + 1) > a->_found_words) {
+        /* the larger args vector is kept, but not used until this works */
+        size_t new_words = _lsa_WORDS(a->args_cap);
+        unsigned long* new_found = _lsa_realloc(a, a->_found,
+            a->_found_words * sizeof(*new_found),
+            new_words * sizeof(*new_found));
+        if (new_found == NULL) {
+            return 0;
+        }
+        a->_found = new_found;
+        a->_found_words = new_words;
+    }
+#ifdef LS_ARGS_NO_SHORT_TABLE
+    if (a->args_len + 1 > a->_shorts_cap) {
+        size_t new_cap = (a->args_cap + 31) / 32 * 32;
+        unsigned char* new_shorts
+            = _lsa_realloc(a, a->_shorts, a->_shorts_cap, new_cap);
+        if (new_shorts == NULL) {
+            return 0;
+        }
+        /* positionals and the padding have no short option */
+        memset(new_shorts + a->_shorts_cap, 0, new_cap - a->_shorts_cap);
+        a->_shorts = new_shorts;
+        a->_shorts_cap = new_cap;
+    }
+#endif
     *arg = &a->args[a->args_len++];
     return 1;
 }
 
 void ls_args_init(ls_args* a) {
     memset(a, 0, sizeof(*a));
-    a->last_error = "Success";
+    _lsa_set_error_code(a, LS_ARGS_OK);
+}
+
+void ls_args_set_allocator(ls_args* a, const ls_args_allocator* allocator) {
+    assert(a != NULL);
+    assert(allocator != NULL && allocator->resize != NULL);
+    /* switching with live allocations would free them with the wrong one */
+    assert(a->args == NULL && a->_allocated_help == NULL);
+    a->_alloc = *allocator;
+}
+
+/* FNV-1a */
+static uint32_t _lsa_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    while (len-- > 0) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* murmur3's finalizer, spreads the bits of a hash */
+static uint32_t _lsa_mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+typedef struct _lsa_slot {
+    uint32_t hash;
+    /* of the name; fits into the padding after `hash` */
+    uint32_t len;
+    /* index into `args` plus one, 0 means empty */
+    size_t arg;
+} _lsa_slot;
+
+/* Whether `slot` holds the long option `name` of `len` bytes. Only a slot whose
+ * hash and length both match needs a look at the name. */
+static int _lsa_slot_is(const ls_args* a, const _lsa_slot* slot, uint32_t h,
+    const char* name, size_t len) {
+    return slot->hash == h && slot->len == len
+        && memcmp(a->args[slot->arg - 1].long_opt, name, len) == 0;
+}
+
+/* Built by `ls_args_compile`, in a single allocation:
+ * [header][slots][positional index][displacements] */
+struct _lsa_compiled {
+    /* long options, hash-and-displace perfect hash: a name with hash `h` can
+     * only be in `slots[_lsa_mix(h ^ disp[h % buckets]) & mask]` */
+    _lsa_slot* slots;
+    size_t mask;
+    uint32_t* disp;
+    size_t buckets;
+    /* same as the `_pos_index` before compiling */
+    size_t* pos_index;
+    /* of the whole allocation */
+    size_t size;
+};
+
+/* Looks up a long option by name (without the leading dashes, `len` bytes),
+ * NULL if there is no such option. Every probe that hits an occupied slot is a
+ * candidate, so misses stop at the first empty slot instead of scanning all
+ * arguments. */
+static ls_args_arg* _lsa_long_find(
+    const ls_args* a, const char* name, size_t len) {
+    size_t mask, i;
+    uint32_t h;
+    if (a->_table != NULL) {
+        size_t k = a->_table->match_long(name, len);
+        return k != 0 ? &a->args[k - 1] : NULL;
+    }
+    h = _lsa_hash(name, len);
+    if (a->_compiled != NULL) {
+        /* perfect hash, a single slot to look at */
+        const struct _lsa_compiled* c = a->_compiled;
+        const _lsa_slot* slot
+            = &c->slots[_lsa_mix(h ^ c->disp[h % c->buckets]) & c->mask];
+        if (slot->arg != 0 && _lsa_slot_is(a, slot, h, name, len)) {
+            return &a->args[slot->arg - 1];
+        }
+        return NULL;
+    }
+    if (a->_borrowed) {
+        /* a spec from `ls_args_use_array`, which has no index */
+        for (i = 0; i < a->args_len; ++i) {
+            ls_args_arg* arg = &a->args[i];
+            if (!arg->is_pos && arg->long_opt != NULL
+                && strcmp(arg->long_opt, name) == 0) {
+                return arg;
+            }
+        }
+        return NULL;
+    }
+    if (a->_long_index_cap == 0) {
+        return NULL;
+    }
+    mask = a->_long_index_cap - 1;
+    i = h & mask;
+    while (a->_long_index[i].arg != 0) {
+        if (_lsa_slot_is(a, &a->_long_index[i], h, name, len)) {
+            return &a->args[a->_long_index[i].arg - 1];
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+/* Places the slot without checking for duplicates or capacity. */
+static void _lsa_long_place(_lsa_slot* index, size_t cap, _lsa_slot slot) {
+    size_t mask = cap - 1;
+    size_t i = slot.hash & mask;
+    while (index[i].arg != 0) {
+        i = (i + 1) & mask;
+    }
+    index[i] = slot;
+}
+
+/* Adds `a->args[arg_i]` to the long option index. The index stores positions
+ * rather than pointers, so it stays valid when `_lsa_add` moves the args.
+ * 0 on failure, 1 on success */
+static int _lsa_long_insert(ls_args* a, size_t arg_i) {
+    const char* name = a->args[arg_i].long_opt;
+    size_t len = strlen(name);
+    _lsa_slot slot;
+    if (len > UINT32_MAX) {
+        return 0;
+    }
+    if (_lsa_long_find(a, name, len) != NULL) {
+        /* the first registration wins, like it always did */
+        return 1;
+    }
+    slot.hash = _lsa_hash(name, len);
+    slot.len = (uint32_t)len;
+    slot.arg = arg_i + 1;
+    /* keep the load factor at or below 1/2 so probe sequences stay short */
+    if ((a->_long_count + 1) * 2 > a->_long_index_cap) {
+        size_t new_cap = a->_long_index_cap ? a->_long_index_cap * 2 : 16;
+        _lsa_slot* new_index;
+        size_t i;
+        if (new_cap > SIZE_MAX / sizeof(*new_index)) {
+            return 0;
+        }
+        new_index = _lsa_realloc(a, NULL, 0, new_cap * sizeof(*new_index));
+        if (new_index == NULL) {
+            return 0;
+        }
+        memset(new_index, 0, new_cap * sizeof(*new_index));
+        for (i = 0; i < a->_long_index_cap; ++i) {
+            if (a->_long_index[i].arg != 0) {
+                _lsa_long_place(new_index, new_cap, a->_long_index[i]);
+            }
+        }
+        _lsa_free(a, a->_long_index,
+            a->_long_index_cap * sizeof(*a->_long_index));
+        a->_long_index = new_index;
+        a->_long_index_cap = new_cap;
+    }
+    _lsa_long_place(a->_long_index, a->_long_index_cap, slot);
+    a->_long_count += 1;
+    return 1;
 }
 
 int _lsa_register(ls_args* a, void* val, ls_args_type type,
@@ -324,21 +1426,42 @@ int _lsa_register(ls_args* a, void* val, ls_args_type type,
             short_opt++;
     /* if short_opt isn't null, it must be 1 char */
     assert(short_opt == NULL || strlen(short_opt) == 1);
+    assert(!a->_frozen);
     ret = _lsa_add(a, &arg);
     if (ret == 0) {
-        a->last_error = _lsa_ALLOC_FAIL_STR;
+        _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
         return 0;
     }
     /* TODO: sanity check that there are no dashes in there, because that would
      * be a misuse of the API. */
     /* the rest may be NULL */
     arg->type = type;
-    arg->match.name.short_opt = short_opt;
-    arg->match.name.long_opt = long_opt;
+    arg->short_opt = short_opt;
+    arg->long_opt = long_opt;
     arg->is_pos = 0;
     arg->help = help;
     arg->mode = mode;
     arg->val_ptr = val;
+    if (long_opt != NULL && !_lsa_long_insert(a, a->args_len - 1)) {
+        /* roll back so a failed registration leaves no trace */
+        a->args_len -= 1;
+        _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
+        return 0;
+    }
+    /* the first registration wins, like it always did */
+#ifdef LS_ARGS_NO_SHORT_TABLE
+    if (short_opt != NULL) {
+        /* the search finds the first one */
+        a->_shorts[a->args_len - 1] = (unsigned char)*short_opt;
+    }
+#else
+    if (short_opt != NULL && a->_short_index[(unsigned char)*short_opt] == 0) {
+        a->_short_index[(unsigned char)*short_opt] = a->args_len;
+    }
+#endif
+    if (mode == LS_ARGS_REQUIRED) {
+        a->_required_count += 1;
+    }
     return 1;
 }
 
@@ -354,8 +1477,71 @@ int ls_args_string(ls_args* a, const char** val, const char* short_opt,
         a, val, LS_ARGS_TYPE_STRING, short_opt, long_opt, help, mode);
 }
 
-int ls_args_pos_string(
-    ls_args* a, const char** val, const char* name, ls_args_mode mode) {
+int ls_args_int64(ls_args* a, int64_t* val, const char* short_opt,
+    const char* long_opt, const char* help, ls_args_mode mode) {
+    return _lsa_register(
+        a, val, LS_ARGS_TYPE_INT64, short_opt, long_opt, help, mode);
+}
+
+int ls_args_uint64(ls_args* a, uint64_t* val, const char* short_opt,
+    const char* long_opt, const char* help, ls_args_mode mode) {
+    return _lsa_register(
+        a, val, LS_ARGS_TYPE_UINT64, short_opt, long_opt, help, mode);
+}
+
+int ls_args_double(ls_args* a, double* val, const char* short_opt,
+    const char* long_opt, const char* help, ls_args_mode mode) {
+    return _lsa_register(
+        a, val, LS_ARGS_TYPE_DOUBLE, short_opt, long_opt, help, mode);
+}
+
+/* Appends to the positional index, the slot is `a->_next_pos`. 0 on failure, 1
+ * on success */
+static int _lsa_pos_append(ls_args* a, size_t arg_i) {
+    if (a->_next_pos + 1 > a->_pos_cap) {
+        size_t* new_index;
+        size_t new_cap = a->_pos_cap + a->_pos_cap / 2 + 8;
+        if (new_cap > SIZE_MAX / sizeof(*new_index)) {
+            return 0;
+        }
+        new_index = _lsa_realloc(a, a->_pos_index,
+            a->_pos_cap * sizeof(*new_index), new_cap * sizeof(*new_index));
+        if (new_index == NULL) {
+            return 0;
+        }
+        a->_pos_cap = new_cap;
+        a->_pos_index = new_index;
+    }
+    a->_pos_index[a->_next_pos] = arg_i;
+    return 1;
+}
+
+/* Returns the positional number `pos`, which must exist */
+static ls_args_arg* _lsa_pos_arg(const ls_args* a, size_t pos) {
+    size_t i;
+    if (a->_pos_index != NULL) {
+        return &a->args[a->_pos_index[pos]];
+    }
+    /* a spec from `ls_args_use_array` has no index */
+    for (i = 0;; ++i) {
+        if (a->args[i].is_pos && pos-- == 0) {
+            return &a->args[i];
+        }
+    }
+}
+
+/* Returns the variadic positional, if one is declared. It's always last. */
+static ls_args_arg* _lsa_pos_rest(const ls_args* a) {
+    ls_args_arg* last;
+    if (a->_next_pos == 0) {
+        return NULL;
+    }
+    last = _lsa_pos_arg(a, a->_next_pos - 1);
+    return last->type == LS_ARGS_TYPE_REST ? last : NULL;
+}
+
+static int _lsa_register_pos(ls_args* a, void* val, ls_args_type type,
+    const char* name, ls_args_mode mode) {
     /* TODO: The semantics are unclear when the first arg is not required but
      * the second is. Effectively, the first becomes required, too, because the
      * second cannot be the second without the first. */
@@ -363,20 +1549,44 @@ int ls_args_pos_string(
     int ret;
     assert(a != NULL);
     assert(val != NULL);
+    /* nothing can follow the variadic positional */
+    assert(_lsa_pos_rest(a) == NULL);
+    assert(!a->_frozen);
     ret = _lsa_add(a, &arg);
     if (ret == 0) {
-        a->last_error = _lsa_ALLOC_FAIL_STR;
+        _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
         return 0;
     }
-    arg->type = LS_ARGS_TYPE_STRING;
-    arg->match.pos = a->_next_pos++;
-    arg->help = name;
-    arg->mode = mode;
+    if (!_lsa_pos_append(a, a->args_len - 1)) {
+        /* roll back so a failed registration leaves no trace */
+        a->args_len -= 1;
+        _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
+        return 0;
+    }
+    arg->type = type;
+    arg->short_opt = NULL;
+    arg->long_opt = NULL;
+    a->_next_pos += 1;
+    arg->help = name;
+    arg->mode = mode;
     arg->val_ptr = val;
     arg->is_pos = 1;
+    if (mode == LS_ARGS_REQUIRED) {
+        a->_required_count += 1;
+    }
     return 1;
 }
 
+int ls_args_pos_string(
+    ls_args* a, const char** val, const char* name, ls_args_mode mode) {
+    return _lsa_register_pos(a, val, LS_ARGS_TYPE_STRING, name, mode);
+}
+
+int ls_args_pos_rest(
+    ls_args* a, ls_args_rest* val, const char* name, ls_args_mode mode) {
+    return _lsa_register_pos(a, val, LS_ARGS_TYPE_REST, name, mode);
+}
+
 typedef enum _lsa_parsed_type {
     LS_ARGS_PARSED_ERROR = 0,
     LS_ARGS_PARSED_LONG = 1,
@@ -397,6 +1607,8 @@ typedef struct _lsa_parsed {
         /* an argument provided without `--`, in full */
         const char* positional;
     } as;
+    /* length of `as.long_arg` */
+    size_t long_len;
 } _lsa_parsed;
 
 static _lsa_parsed _lsa_parse(const char* s) {
@@ -421,6 +1633,7 @@ static _lsa_parsed _lsa_parse(const char* s) {
             }
             res.type = LS_ARGS_PARSED_LONG;
             res.as.long_arg = &s[2];
+            res.long_len = remaining;
         } else {
             /* short opt */
             /* guaranteed to be the right size due to earlier checks */
@@ -436,165 +1649,590 @@ end:
     return res;
 }
 
-static void _lsa_apply(ls_args_arg* arg, ls_args_arg** prev_arg) {
-    arg->found = 1;
+/* Everything a single parse reads and writes besides the (read-only) spec. */
+typedef struct _lsa_state {
+    const ls_args* a;
+    ls_args_error_info* err;
+    /* one bit per argument, see `_lsa_mark_found` */
+    unsigned long* found;
+    /* if set, an argument is found if its stamp is `epoch` instead, and
+     * `found` is unused */
+    unsigned* stamps;
+    unsigned epoch;
+    size_t required_left;
+    /* if set, values are written to `base` at the offset their registered
+     * `val_ptr` has from `layout`, see `ls_args_ctx_init` */
+    char* base;
+    const char* layout;
+    /* if set, values are handed to these instead, see
+     * `ls_args_parse_events` */
+    const ls_args_events* events;
+} _lsa_state;
+
+static void _lsa_state_init(_lsa_state* st, const ls_args* a,
+    ls_args_error_info* err, unsigned long* found) {
+    st->a = a;
+    st->err = err;
+    st->found = found;
+    st->stamps = NULL;
+    st->epoch = 0;
+    st->required_left = a->_required_count;
+    st->base = NULL;
+    st->layout = NULL;
+    st->events = NULL;
+    /* set all args to not found in case this is called multiple times */
+    if (found != NULL && a->args_len > 0) {
+        memset(found, 0, _lsa_WORDS(a->args_len) * sizeof(*found));
+    }
+}
+
+/* Where the value of `arg` goes in this parse */
+static void* _lsa_val(const _lsa_state* st, const ls_args_arg* arg) {
+    if (st->layout == NULL) {
+        return arg->val_ptr;
+    }
+    return st->base + ((const char*)arg->val_ptr - st->layout);
+}
+
+/* Marks the argument as seen in the current parse. Returns 1 if it's the first
+ * time, 0 if it was seen before. */
+static int _lsa_mark_found(_lsa_state* st, const ls_args_arg* arg) {
+    size_t k = (size_t)(arg - st->a->args);
+    if (st->stamps != NULL) {
+        if (st->stamps[k] == st->epoch) {
+            return 0;
+        }
+        st->stamps[k] = st->epoch;
+    } else {
+        unsigned long bit = 1UL << (k % _lsa_WORD_BITS);
+        unsigned long* word = &st->found[k / _lsa_WORD_BITS];
+        if (*word & bit) {
+            return 0;
+        }
+        *word |= bit;
+    }
+    if (arg->mode == LS_ARGS_REQUIRED) {
+        st->required_left -= 1;
+    }
+    return 1;
+}
+
+static int _lsa_is_found(const _lsa_state* st, const ls_args_arg* arg) {
+    size_t k = (size_t)(arg - st->a->args);
+    if (st->stamps != NULL) {
+        return st->stamps[k] == st->epoch;
+    }
+    return (st->found[k / _lsa_WORD_BITS] >> (k % _lsa_WORD_BITS)) & 1;
+}
+
+/* Whether the option `arg` is followed by a value */
+static int _lsa_takes_value(const ls_args_arg* arg) {
+    return arg->type != LS_ARGS_TYPE_BOOL && arg->type != LS_ARGS_TYPE_REST;
+}
+
+/* Whether `s` is the value of the option `arg` even though it starts with a
+ * dash, like the `-5` of `--offset -5`. Only numeric options take those. */
+static int _lsa_negative_value(const ls_args_arg* arg, const char* s) {
+    return (arg->type == LS_ARGS_TYPE_INT64 || arg->type == LS_ARGS_TYPE_UINT64
+               || arg->type == LS_ARGS_TYPE_DOUBLE)
+        && s[0] == '-' && ((unsigned)(s[1] - '0') <= 9 || s[1] == '.');
+}
+
+/* 10^19, the smallest number with 20 digits */
+#define _lsa_E19 ((uint64_t)1000000000 * 1000000000 * 10)
+
+/* Converts `s`, which must be nothing but decimal digits, into `*out`. Returns
+ * LS_ARGS_ERR_NUMBER if it isn't, and LS_ARGS_ERR_RANGE if it doesn't fit into
+ * 64 bits. */
+static ls_args_error_code _lsa_to_digits(const char* s, uint64_t* out) {
+    uint64_t v = 0;
+    size_t n;
+    /* leading zeros can't overflow anything */
+    while (s[0] == '0' && (unsigned)(s[1] - '0') <= 9) {
+        ++s;
+    }
+    /* only the loop condition branches, overflow is checked after */
+    for (n = 0; (unsigned)(s[n] - '0') <= 9; ++n) {
+        v = v * 10 + (unsigned)(s[n] - '0');
+    }
+    if (n == 0 || s[n] != '\0') {
+        return LS_ARGS_ERR_NUMBER;
+    }
+    /* a 20 digit number starting with 1 that wrapped around is below 10^19,
+     * anything longer or bigger always overflows */
+    if (n > 20 || (n == 20 && (s[0] != '1' || v < _lsa_E19))) {
+        return LS_ARGS_ERR_RANGE;
+    }
+    *out = v;
+    return LS_ARGS_OK;
+}
+
+static ls_args_error_code _lsa_to_int64(const char* s, int64_t* out) {
+    int neg = *s == '-';
+    uint64_t mag;
+    ls_args_error_code code = _lsa_to_digits(s + (neg || *s == '+'), &mag);
+    if (code != LS_ARGS_OK) {
+        return code;
+    }
+    /* INT64_MIN has no positive counterpart */
+    if (mag > (uint64_t)INT64_MAX + (unsigned)neg) {
+        return LS_ARGS_ERR_RANGE;
+    }
+    *out = neg && mag > 0 ? -(int64_t)(mag - 1) - 1 : (int64_t)mag;
+    return LS_ARGS_OK;
+}
+
+static ls_args_error_code _lsa_to_uint64(const char* s, uint64_t* out) {
+    int neg = *s == '-';
+    ls_args_error_code code = _lsa_to_digits(s + (neg || *s == '+'), out);
+    if (code == LS_ARGS_OK && neg && *out != 0) {
+        return LS_ARGS_ERR_RANGE;
+    }
+    return code;
+}
+
+/* Powers of ten that are exact as doubles */
+static const double _lsa_pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+    1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+    1e21, 1e22 };
+
+/* Significant digits `_lsa_to_double_slow` hands to strtod(3). Deciding the
+ * rounding of any double takes at most 768 of them. */
+#define _lsa_DIGITS_MAX 800
+
+/* Converts the number `s`, which `_lsa_to_double` found to be valid, with
+ * strtod(3). Rewrites it into digits and an exponent first, without a decimal
+ * point, so that the locale doesn't matter. */
+static ls_args_error_code _lsa_to_double_slow(const char* s, double* out) {
+    /* digits, a sticky digit, and `e` with the exponent */
+    char buf[_lsa_DIGITS_MAX + 16];
+    size_t n = 0;
+    long exp10 = 0;
+    long e = 0;
+    int fraction = 0;
+    int e_neg;
+    int sticky = 0;
+    double v;
+    for (; (unsigned)(*s - '0') <= 9 || *s == '.'; ++s) {
+        if (*s == '.') {
+            fraction = 1;
+        } else if (n == 0 && *s == '0') {
+            exp10 -= fraction;
+        } else if (n < _lsa_DIGITS_MAX) {
+            buf[n++] = *s;
+            exp10 -= fraction;
+        } else {
+            exp10 += !fraction;
+            sticky |= *s != '0';
+        }
+    }
+    if (n == 0) {
+        *out = 0.0;
+        return LS_ARGS_OK;
+    }
+    /* anything that was cut off only needs to push the value up a bit */
+    if (sticky) {
+        buf[n++] = '1';
+        exp10 -= 1;
+    }
+    if (*s == 'e' || *s == 'E') {
+        ++s;
+        e_neg = *s == '-';
+        s += *s == '-' || *s == '+';
+        for (; *s != '\0'; ++s) {
+            if (e < 100000) {
+                e = e * 10 + (*s - '0');
+            }
+        }
+        exp10 += e_neg ? -e : e;
+    }
+    /* way past what a double can hold either way */
+    if (exp10 > 100000) {
+        exp10 = 100000;
+    } else if (exp10 < -100000) {
+        exp10 = -100000;
+    }
+    sprintf(buf + n, "e%ld", exp10);
+    v = strtod(buf, NULL);
+    if (v == HUGE_VAL) {
+        return LS_ARGS_ERR_RANGE;
+    }
+    *out = v;
+    return LS_ARGS_OK;
+}
+
+/* Converts `s` into `*out`. Up to 19 significant digits and with a small
+ * exponent, which is the usual case, the result is a single exactly rounded
+ * multiplication or division. Anything else goes to `_lsa_to_double_slow`. */
+static ls_args_error_code _lsa_to_double(const char* s, double* out) {
+    const char* p = s;
+    int neg = *p == '-';
+    uint64_t mant = 0;
+    int digits = 0;
+    int seen = 0;
+    int exact = 1;
+    int fraction = 0;
+    long exp10 = 0;
+    long e = 0;
+    int e_neg;
+    ls_args_error_code code = LS_ARGS_OK;
+    p += *p == '-' || *p == '+';
+    s = p;
+    for (;; ++p) {
+        unsigned d = (unsigned)(*p - '0');
+        if (d > 9) {
+            if (*p != '.' || fraction) {
+                break;
+            }
+            fraction = 1;
+            continue;
+        }
+        seen = 1;
+        if (mant == 0 && d == 0) {
+            exp10 -= fraction;
+        } else if (digits < 19) {
+            mant = mant * 10 + d;
+            digits += 1;
+            exp10 -= fraction;
+        } else {
+            exp10 += !fraction;
+            exact &= d == 0;
+        }
+    }
+    if (seen && (*p == 'e' || *p == 'E')) {
+        ++p;
+        e_neg = *p == '-';
+        p += *p == '-' || *p == '+';
+        if ((unsigned)(*p - '0') > 9) {
+            return LS_ARGS_ERR_NUMBER;
+        }
+        for (; (unsigned)(*p - '0') <= 9; ++p) {
+            if (e < 100000) {
+                e = e * 10 + (*p - '0');
+            }
+        }
+        exp10 += e_neg ? -e : e;
+    }
+    if (!seen || *p != '\0') {
+        return LS_ARGS_ERR_NUMBER;
+    }
+    if (mant == 0) {
+        *out = 0.0;
+    } else if (exact && mant <= (uint64_t)1 << 53 && exp10 >= -22
+        && exp10 <= 22) {
+        *out = exp10 < 0 ? (double)mant / _lsa_pow10[-exp10]
+                         : (double)mant * _lsa_pow10[exp10];
+    } else {
+        code = _lsa_to_double_slow(s, out);
+    }
+    if (code == LS_ARGS_OK && neg) {
+        *out = -*out;
+    }
+    return code;
+}
+
+/* What a numeric option converts to */
+typedef union _lsa_number {
+    int64_t i;
+    uint64_t u;
+    double d;
+} _lsa_number;
+
+/* Converts `value` for the option `arg` into `*n`, if it's numeric */
+static ls_args_error_code _lsa_convert(
+    const ls_args_arg* arg, const char* value, _lsa_number* n) {
+    switch (arg->type) {
+    case LS_ARGS_TYPE_INT64:
+        return _lsa_to_int64(value, &n->i);
+    case LS_ARGS_TYPE_UINT64:
+        return _lsa_to_uint64(value, &n->u);
+    case LS_ARGS_TYPE_DOUBLE:
+        return _lsa_to_double(value, &n->d);
+    }
+    return LS_ARGS_OK;
+}
+
+/* Reports the option `arg`, given in `argv[i]`, to the events. Returns 0 if the
+ * callback aborted. */
+static int _lsa_emit_option(_lsa_state* st, const ls_args_arg* arg, int i) {
+    long k = (long)(arg - st->a->args);
+    if (st->events->option != NULL
+        && !st->events->option(st->events->user, arg, k, i)) {
+        return _lsa_fail(st->err, LS_ARGS_ERR_ABORTED, i, k, NULL, 0);
+    }
+    return 1;
+}
+
+/* Reports `argv[i]` as the value of the option or positional `arg` to `cb`.
+ * Returns 0 if the callback aborted. */
+static int _lsa_emit_value(_lsa_state* st,
+    int (*cb)(void*, const ls_args_arg*, long, const char*, int),
+    const ls_args_arg* arg, const char* value, int i) {
+    long k = (long)(arg - st->a->args);
+    if (cb != NULL && !cb(st->events->user, arg, k, value, i)) {
+        return _lsa_fail(st->err, LS_ARGS_ERR_ABORTED, i, k, NULL, 0);
+    }
+    return 1;
+}
+
+/* Applies the option `arg`, given in `argv[i]`. Returns 0 on failure. */
+static int _lsa_apply(
+    _lsa_state* st, ls_args_arg* arg, ls_args_arg** prev_arg, int i) {
+    _lsa_mark_found(st, arg);
+    if (st->events != NULL) {
+        *prev_arg = _lsa_takes_value(arg) ? arg : NULL;
+        return _lsa_emit_option(st, arg, i);
+    }
     switch (arg->type) {
     case LS_ARGS_TYPE_BOOL:
-        *(int*)arg->val_ptr = 1;
+        *(int*)_lsa_val(st, arg) = 1;
         *prev_arg = NULL;
         break;
     case LS_ARGS_TYPE_STRING:
+    case LS_ARGS_TYPE_INT64:
+    case LS_ARGS_TYPE_UINT64:
+    case LS_ARGS_TYPE_DOUBLE:
+        /* the value comes with the next argument, see `_lsa_apply_value` */
         *prev_arg = arg;
         break;
+    case LS_ARGS_TYPE_REST:
+        /* only ever positional */
+        assert(0);
+        break;
+    }
+    return 1;
+}
+
+/* Applies `value`, given in `argv[i]`, to the option `arg` which preceded it,
+ * converting it if it's numeric. Returns 0 on failure. */
+static int _lsa_apply_value(
+    _lsa_state* st, const ls_args_arg* arg, const char* value, int i) {
+    _lsa_number n;
+    ls_args_error_code code = _lsa_convert(arg, value, &n);
+    if (code != LS_ARGS_OK) {
+        return _lsa_fail(
+            st->err, code, i, (long)(arg - st->a->args), value, 0);
+    }
+    if (st->events != NULL) {
+        return _lsa_emit_value(st, st->events->value, arg, value, i);
+    }
+    switch (arg->type) {
+    case LS_ARGS_TYPE_STRING:
+        *(const char**)_lsa_val(st, arg) = value;
+        break;
+    case LS_ARGS_TYPE_INT64:
+        *(int64_t*)_lsa_val(st, arg) = n.i;
+        break;
+    case LS_ARGS_TYPE_UINT64:
+        *(uint64_t*)_lsa_val(st, arg) = n.u;
+        break;
+    case LS_ARGS_TYPE_DOUBLE:
+        *(double*)_lsa_val(st, arg) = n.d;
+        break;
     }
+    return 1;
 }
 
 static int _lsa_parse_long(
-    ls_args* a, _lsa_parsed* parsed, ls_args_arg** prev_arg) {
-    int found = 0;
-    size_t k;
-    for (k = 0; k < a->args_len; ++k) {
-        if (a->args[k].is_pos) {
-            continue;
+    _lsa_state* st, _lsa_parsed* parsed, int i, ls_args_arg** prev_arg) {
+    ls_args_arg* arg
+        = _lsa_long_find(st->a, parsed->as.long_arg, parsed->long_len);
+    if (arg == NULL) {
+        return _lsa_fail(st->err, LS_ARGS_ERR_UNKNOWN_LONG, i, -1,
+            parsed->as.long_arg, 0);
+    }
+    return _lsa_apply(st, arg, prev_arg, i);
+}
+
+#ifdef LS_ARGS_NO_SHORT_TABLE
+#if defined(__GNUC__)
+#define _lsa_ctz(x) ((size_t)__builtin_ctz(x))
+#else
+static size_t _lsa_ctz(unsigned x) {
+    size_t n = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        n += 1;
+    }
+    return n;
+}
+#endif
+
+/* Finds the short option `c`, which is never 0, in the first `len` entries of
+ * `shorts`. Returns the index into `args` plus one, or 0 if there is none.
+ * Reads whole 32 byte blocks, which the zero padding of `shorts` allows. */
+static size_t _lsa_short_find(
+    const unsigned char* shorts, size_t len, unsigned char c) {
+    size_t end = (len + 31) / 32 * 32;
+#if defined(_lsa_SHORT_AVX2)
+    __m256i needle = _mm256_set1_epi8((char)c);
+    size_t i;
+    for (i = 0; i < end; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(shorts + i));
+        unsigned mask
+            = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return i + _lsa_ctz(mask) + 1;
         }
-        if (a->args[k].match.name.long_opt != NULL
-            && strcmp(parsed->as.long_arg, a->args[k].match.name.long_opt)
-                == 0) {
-            _lsa_apply(&a->args[k], prev_arg);
-            found = 1;
-            break;
+    }
+    return 0;
+#elif defined(_lsa_SHORT_SSE2)
+    __m128i needle = _mm_set1_epi8((char)c);
+    size_t i;
+    for (i = 0; i < end; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(shorts + i));
+        unsigned mask
+            = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return i + _lsa_ctz(mask) + 1;
         }
     }
-    if (!found) {
-        const size_t len = 32 + strlen(parsed->as.erroneous);
-        if (!_lsa_set_error(
-                a, len, "Invalid argument '--%s'", parsed->as.erroneous)) {
-            return 0;
+    return 0;
+#elif defined(_lsa_SHORT_NEON)
+    uint8x16_t needle = vdupq_n_u8(c);
+    size_t i;
+    for (i = 0; i < end; i += 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(shorts + i), needle);
+        /* narrows each 0x00 or 0xff byte to a nibble, 16 in 64 bits */
+        uint32x2_t mask = vreinterpret_u32_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(eq), 4));
+        unsigned lo = vget_lane_u32(mask, 0);
+        unsigned hi = vget_lane_u32(mask, 1);
+        if (lo != 0) {
+            return i + _lsa_ctz(lo) / 4 + 1;
+        }
+        if (hi != 0) {
+            return i + 8 + _lsa_ctz(hi) / 4 + 1;
         }
-        return 0;
     }
-    return 1;
+    return 0;
+#else
+    const unsigned char* p = end > 0 ? memchr(shorts, c, end) : NULL;
+    return p != NULL ? (size_t)(p - shorts) + 1 : 0;
+#endif
+}
+#endif
+
+/* Index into `args` plus one of the short option `c`, 0 if there is none */
+static size_t _lsa_short_lookup(const ls_args* a, char c) {
+    if (a->_table != NULL) {
+        return a->_table->match_short((unsigned char)c);
+    }
+#ifdef LS_ARGS_NO_SHORT_TABLE
+    return _lsa_short_find(a->_shorts, a->args_len, (unsigned char)c);
+#else
+    return a->_short_index[(unsigned char)c];
+#endif
 }
 
 static int _lsa_parse_short(
-    ls_args* a, _lsa_parsed* parsed, ls_args_arg** prev_arg) {
+    _lsa_state* st, _lsa_parsed* parsed, int i, ls_args_arg** prev_arg) {
     const char* args = parsed->as.short_args;
     while (*args) {
         char arg = *args++;
-        int found = 0;
         size_t k;
         if (*prev_arg) {
-            struct _lsa_spec named = (*prev_arg)->match.name;
-            const size_t len = 128 + strlen(named.short_opt);
-            if (!_lsa_set_error(a, len,
-                    "Expected argument following '-%s', instead got another "
-                    "argument '-%c'",
-                    named.short_opt, arg)) {
-                return 0;
-            }
-            return 0;
+            return _lsa_fail(st->err, LS_ARGS_ERR_MISSING_VALUE, i,
+                (long)(*prev_arg - st->a->args), NULL, arg);
         }
-        for (k = 0; k < a->args_len; ++k) {
-            const char* opt;
-            if (a->args[k].is_pos) {
-                continue;
-            }
-            opt = a->args[k].match.name.short_opt;
-            if (opt != NULL && opt[0] == arg) {
-                _lsa_apply(&a->args[k], prev_arg);
-                found = 1;
-                break;
-            }
+        k = _lsa_short_lookup(st->a, arg);
+        if (k == 0) {
+            return _lsa_fail(
+                st->err, LS_ARGS_ERR_UNKNOWN_SHORT, i, -1, NULL, arg);
         }
-        if (!found) {
-            const size_t len = 32;
-            if (!_lsa_set_error(a, len, "Invalid argument '-%c'", arg)) {
-                return 0;
-            }
+        if (!_lsa_apply(st, &st->a->args[k - 1], prev_arg, i)) {
             return 0;
         }
     }
     return 1;
 }
 
+/* Binds `argv[i]` as the positional number `pos`. */
 static int _lsa_parse_positional(
-    ls_args* a, _lsa_parsed* parsed, unsigned pos) {
-    const size_t len = 32;
-    size_t i;
-    for (i = 0; i < a->args_len; ++i) {
-        ls_args_arg* arg = &a->args[i];
-        if (arg->is_pos && arg->match.pos == pos) {
-            *(const char**)arg->val_ptr = parsed->as.positional;
-            arg->found = 1;
-            return 1;
+    _lsa_state* st, char** argv, int i, unsigned pos) {
+    const ls_args* a = st->a;
+    ls_args_arg* arg;
+    ls_args_rest* rest;
+    if (pos >= a->_next_pos) {
+        arg = _lsa_pos_rest(a);
+        if (arg == NULL) {
+            return _lsa_fail(
+                st->err, LS_ARGS_ERR_UNEXPECTED, i, -1, argv[i], 0);
         }
+    } else {
+        arg = _lsa_pos_arg(a, pos);
     }
-    if (!_lsa_set_error(
-            a, len, "Unexpected argument '%s'", parsed->as.positional)) {
-        return 0;
+    if (st->events != NULL) {
+        _lsa_mark_found(st, arg);
+        return _lsa_emit_value(st, st->events->positional, arg, argv[i], i);
     }
-    return 0;
+    if (arg->type == LS_ARGS_TYPE_STRING) {
+        *(const char**)_lsa_val(st, arg) = argv[i];
+        _lsa_mark_found(st, arg);
+        return 1;
+    }
+    rest = (ls_args_rest*)_lsa_val(st, arg);
+    if (_lsa_mark_found(st, arg)) {
+        rest->begin = &argv[i];
+        rest->count = 0;
+    } else if (&rest->begin[rest->count] != &argv[i]) {
+        /* Everything between the end of the rest and `i` has been consumed
+         * already, so swapping keeps the rest contiguous in O(1) while argv
+         * stays a permutation of itself. */
+        char* tmp = rest->begin[rest->count];
+        rest->begin[rest->count] = argv[i];
+        argv[i] = tmp;
+    }
+    rest->count += 1;
+    return 1;
 }
 
-int ls_args_parse(ls_args* a, int argc, char** argv) {
+static int _lsa_parse_argv(_lsa_state* st, int argc, char** argv) {
+    const ls_args* a = st->a;
     int i;
     unsigned pos_i = 0;
     ls_args_arg* prev_arg = NULL;
-    assert(a != NULL);
-    assert(argv != NULL);
-    a->last_error = "Success";
-    a->program_name = argv[0];
-    /* set all args to not found in case this is called multiple times */
-    for (i = 0; i < (int)a->args_len; ++i) {
-        a->args[i].found = 0;
-    }
+    /* where prev_arg was given */
+    int prev_i = 0;
     for (i = 1; i < argc; ++i) {
         _lsa_parsed parsed = _lsa_parse(argv[i]);
         if (prev_arg) {
-            if (parsed.type != LS_ARGS_PARSED_POSITIONAL) {
+            const char* value = argv[i];
+            if (parsed.type == LS_ARGS_PARSED_POSITIONAL) {
+                value = parsed.as.positional;
+            } else if (!_lsa_negative_value(prev_arg, value)) {
                 /* argument for the previous param expected, but none given */
-                const size_t len = 64 + strlen(prev_arg->match.name.long_opt);
-                if (!_lsa_set_error(a, len,
-                        "Expected argument following '--%s'",
-                        prev_arg->match.name.long_opt)) {
-                    return 0;
-                }
-                return 0;
+                return _lsa_fail(st->err, LS_ARGS_ERR_MISSING_VALUE, i,
+                    (long)(prev_arg - a->args), NULL, 0);
             }
-            if (prev_arg->type == LS_ARGS_TYPE_STRING) {
-                *(const char**)prev_arg->val_ptr = parsed.as.positional;
+            if (!_lsa_apply_value(st, prev_arg, value, i)) {
+                return 0;
             }
             prev_arg = NULL;
             continue;
         }
         switch (parsed.type) {
-        case LS_ARGS_PARSED_ERROR: {
-            const size_t len = 32 + strlen(parsed.as.erroneous);
-            if (!_lsa_set_error(
-                    a, len, "Invalid argument '%s'", parsed.as.erroneous)) {
-                return 0;
-            }
-            return 0;
-        }
+        case LS_ARGS_PARSED_ERROR:
+            return _lsa_fail(st->err, LS_ARGS_ERR_INVALID, i, -1,
+                parsed.as.erroneous, 0);
         case LS_ARGS_PARSED_LONG: {
-            if (!_lsa_parse_long(a, &parsed, &prev_arg)) {
+            if (!_lsa_parse_long(st, &parsed, i, &prev_arg)) {
                 return 0;
             }
+            prev_i = i;
             break;
         }
         case LS_ARGS_PARSED_SHORT: {
-            if (!_lsa_parse_short(a, &parsed, &prev_arg)) {
+            if (!_lsa_parse_short(st, &parsed, i, &prev_arg)) {
                 return 0;
             }
+            prev_i = i;
             break;
         }
         case LS_ARGS_PARSED_STOP: {
             i += 1;
             for (; i < argc; ++i) {
-                _lsa_parsed parsed;
-                parsed.type = LS_ARGS_PARSED_POSITIONAL;
-                parsed.as.positional = argv[i];
-                if (!_lsa_parse_positional(a, &parsed, pos_i)) {
+                if (!_lsa_parse_positional(st, argv, i, pos_i)) {
                     return 0;
                 }
                 pos_i += 1;
@@ -604,7 +2242,7 @@ int ls_args_parse(ls_args* a, int argc, char** argv) {
             break;
         }
         case LS_ARGS_PARSED_POSITIONAL:
-            if (!_lsa_parse_positional(a, &parsed, pos_i)) {
+            if (!_lsa_parse_positional(st, argv, i, pos_i)) {
                 return 0;
             }
             ++pos_i;
@@ -612,201 +2250,1524 @@ int ls_args_parse(ls_args* a, int argc, char** argv) {
         }
     }
     if (prev_arg) {
-        size_t len;
         /* argument for the previous param expected, but none given */
         /* this can not be a positional argument, because in order to become a
          * prev_arg, it must have expected a value earlier. this is only the
          * case with -/--... arguments */
         assert(!prev_arg->is_pos);
-        len = 64 + strlen(prev_arg->match.name.long_opt);
-        if (!_lsa_set_error(a, len, "Expected argument following '--%s'",
-                prev_arg->match.name.long_opt)) {
-            return 0;
-        }
-        return 0;
+        return _lsa_fail(st->err, LS_ARGS_ERR_MISSING_VALUE, prev_i,
+            (long)(prev_arg - a->args), NULL, 0);
     }
 
+    if (st->required_left == 0) {
+        return 1;
+    }
+    /* only the error path needs to find out which one is missing */
     for (i = 0; i < (int)a->args_len; ++i) {
-        if (a->args[i].mode == LS_ARGS_REQUIRED && !a->args[i].found) {
-            size_t len;
-            if (a->args[i].is_pos) {
-                len = 64;
-                if (!_lsa_set_error(a, len,
-                        "Required argument '%s' not provided",
-                        a->args[i].help)) {
-                    return 0;
-                }
-            } else {
-                len = 64 + strlen(a->args[i].match.name.long_opt);
-                if (!_lsa_set_error(a, len,
-                        "Required argument '--%s' not found",
-                        a->args[i].match.name.long_opt)) {
-                    return 0;
-                }
-            }
-            return 0;
+        if (a->args[i].mode == LS_ARGS_REQUIRED
+            && !_lsa_is_found(st, &a->args[i])) {
+            return _lsa_fail(
+                st->err, LS_ARGS_ERR_REQUIRED, -1, (long)i, NULL, 0);
         }
     }
 
     return 1;
 }
 
-typedef struct _lsa_buffer {
-    char* data;
-    size_t length;
-    size_t capacity;
-} _lsa_buffer;
-
-static int _lsa_buffer_reserve(_lsa_buffer* buffer, size_t required_capacity) {
-    char* new_data;
-
-    if (required_capacity <= buffer->capacity)
-        return 1;
-
-    new_data = (char*)LS_REALLOC(buffer->data, required_capacity);
-    if (!new_data)
-        return 0;
+/* Hands a failed parse to the error callback of `events`, if any. Called once
+ * the error is in place, so that the callback can format it. */
+static void _lsa_report_error(
+    const ls_args_events* events, const ls_args_error_info* err) {
+    if (events != NULL && events->error != NULL
+        && err->code != LS_ARGS_ERR_ABORTED) {
+        events->error(events->user, err);
+    }
+}
 
-    buffer->data = new_data;
-    buffer->capacity = required_capacity;
-    return 1;
+int ls_args_parse(ls_args* a, int argc, char** argv) {
+    return ls_args_parse_events(a, argc, argv, NULL);
 }
 
-static int _lsa_buffer_append_bytes(
-    _lsa_buffer* buffer, const void* source, size_t byte_count) {
-    if (!_lsa_buffer_reserve(buffer, buffer->length + byte_count + 1)) {
-        return 0;
+int ls_args_parse_events(
+    ls_args* a, int argc, char** argv, const ls_args_events* events) {
+    _lsa_state st;
+    int ok;
+    assert(a != NULL);
+    assert(argv != NULL);
+    a->program_name = argv[0];
+    _lsa_state_init(&st, a, &a->error,
+        a->_found != NULL ? a->_found : a->_array_found);
+    st.events = events;
+    ok = _lsa_parse_argv(&st, argc, argv);
+    if (ok) {
+        _lsa_set_error_code(a, LS_ARGS_OK);
+    } else {
+        a->last_error = (char*)_lsa_error_summary(a->error.code);
+        a->_error_formatted = 0;
+        _lsa_report_error(events, &a->error);
     }
-
-    memcpy(buffer->data + buffer->length, source, byte_count);
-
-    buffer->length += byte_count;
-    buffer->data[buffer->length] = '\0';
-    return 1;
+    return ok;
 }
 
-static int _lsa_buffer_append_cstr(_lsa_buffer* buffer, const char* string) {
-    return _lsa_buffer_append_bytes(buffer, string, strlen(string));
+void ls_args_freeze(ls_args* a) {
+    assert(a != NULL);
+    a->_frozen = 1;
 }
 
-char* ls_args_help(ls_args* a) {
-    _lsa_buffer help;
-    if (a->_allocated_help != NULL) {
-        LS_FREE(a->_allocated_help);
-        a->_allocated_help = NULL;
-    }
-    help.data = NULL;
-    help.length = 0;
-    help.capacity = 0;
-
-    if (!_lsa_buffer_append_cstr(&help, "Usage: ")) {
-        goto alloc_fail;
-    }
-    if (a->program_name == NULL) {
-        a->program_name = "<program>";
-    }
-    if (!_lsa_buffer_append_cstr(&help, a->program_name)) {
-        goto alloc_fail;
-    }
-    if (a->args_len > 0) {
-        size_t i;
-        for (i = 0; i < a->args_len; ++i) {
-            if (!a->args[i].is_pos) {
-                if (!_lsa_buffer_append_cstr(&help, " [OPTION]")) {
-                    goto alloc_fail;
-                }
-                break;
-            }
+/* Tries to place every long option into a table of `mask + 1` slots with the
+ * given number of buckets. `order` holds the long options grouped by bucket,
+ * `bucket_start` where each group begins (with one extra entry at the end),
+ * and `by_size` the buckets, largest first. Returns 1 if every bucket found a
+ * displacement. */
+static int _lsa_compile_place(struct _lsa_compiled* c, const _lsa_slot* order,
+    const size_t* bucket_start, const size_t* by_size) {
+    size_t b, k;
+    memset(c->slots, 0, (c->mask + 1) * sizeof(*c->slots));
+    for (b = 0; b < c->buckets; ++b) {
+        size_t bucket = by_size[b];
+        size_t first = bucket_start[bucket];
+        size_t last = bucket_start[bucket + 1];
+        uint32_t d;
+        if (first == last) {
+            /* empty buckets come last */
+            break;
         }
-        for (i = 0; i < a->args_len; ++i) {
-            const char* open, *close;
-            if (!a->args[i].is_pos) {
-                continue;
-            }
-
-            open = a->args[i].mode == LS_ARGS_REQUIRED ? " <" : " [";
-            close = a->args[i].mode == LS_ARGS_REQUIRED ? ">" : "]";
-            if (!_lsa_buffer_append_cstr(&help, open))
-                goto alloc_fail;
-            if (!_lsa_buffer_append_cstr(&help, a->args[i].help))
-                goto alloc_fail;
-            if (!_lsa_buffer_append_cstr(&help, close))
-                goto alloc_fail;
-        }
-        if (a->help_description) {
-            if (!_lsa_buffer_append_cstr(&help, "\n\n"))
-                goto alloc_fail;
-            if (!_lsa_buffer_append_cstr(&help, a->help_description))
-                goto alloc_fail;
-        }
-
-        /* Only print "Options:" if there are non-positional options */
-        {
-            int has_nonpositional = 0;
-            for (i = 0; i < a->args_len; ++i) {
-                if (!a->args[i].is_pos) {
-                    has_nonpositional = 1;
+        /* bounded, so that hash collisions can't loop forever */
+        for (d = 0; d < 65536; ++d) {
+            for (k = first; k < last; ++k) {
+                _lsa_slot* slot
+                    = &c->slots[_lsa_mix(order[k].hash ^ d) & c->mask];
+                if (slot->arg != 0) {
                     break;
                 }
+                /* claim it for now, undone below if the bucket doesn't fit */
+                *slot = order[k];
             }
-            if (has_nonpositional) {
-                if (!_lsa_buffer_append_cstr(&help, "\n\nOptions:"))
-                    goto alloc_fail;
-                for (i = 0; i < a->args_len; ++i) {
-                    if (!a->args[i].is_pos) {
-                        if (!_lsa_buffer_append_cstr(&help, "\n  -"))
-                            goto alloc_fail;
-                        if (!_lsa_buffer_append_cstr(
-                                &help, a->args[i].match.name.short_opt))
-                            goto alloc_fail;
-                        if (!_lsa_buffer_append_cstr(&help, " \t--"))
-                            goto alloc_fail;
-                        if (!_lsa_buffer_append_cstr(
-                                &help, a->args[i].match.name.long_opt))
-                            goto alloc_fail;
-                        if (a->args[i].type != LS_ARGS_TYPE_BOOL) {
-                            if (!_lsa_buffer_append_cstr(&help, " \t"))
-                                goto alloc_fail;
-                            if (a->args[i].mode == LS_ARGS_REQUIRED) {
-                                if (!_lsa_buffer_append_cstr(&help, "<VALUE> \t"))
-                                    goto alloc_fail;
-                            } else {
-                                if (!_lsa_buffer_append_cstr(&help, "[VALUE] \t"))
-                                    goto alloc_fail;
-                            }
-                        } else {
-                            if (!_lsa_buffer_append_cstr(&help, " \t\t\t"))
-                                goto alloc_fail;
-                        }
-                        if (!_lsa_buffer_append_cstr(&help, a->args[i].help))
-                            goto alloc_fail;
-                    }
-                }
+            if (k == last) {
+                break;
+            }
+            while (k-- > first) {
+                c->slots[_lsa_mix(order[k].hash ^ d) & c->mask].arg = 0;
             }
         }
+        if (d == 65536) {
+            return 0;
+        }
+        c->disp[bucket] = d;
     }
-
-    a->_allocated_help = help.data;
-    a->last_error = "Success";
-    return a->_allocated_help;
-alloc_fail:
-    a->_allocated_help = help.data;
-    a->last_error = _lsa_ALLOC_FAIL_STR;
-    return "Not enough memory available to generate help text.";
+    return 1;
 }
 
-void ls_args_free(ls_args* a) {
+int ls_args_compile(ls_args* a) {
+    struct _lsa_compiled* c;
+    size_t n = a->_long_count;
+    size_t buckets = n / 4 + 1;
+    size_t slots = 1;
+    size_t header, size, scratch_size, i, k;
+    _lsa_slot* order;
+    size_t* bucket_start;
+    size_t* by_size;
+    int placed = 0;
+    assert(a != NULL);
+    if (a->_compiled != NULL || a->_borrowed) {
+        /* nothing to replace */
+        return 1;
+    }
+    /* load factor of at most 0.8, which keeps finding displacements quick */
+    while (slots < n + n / 4 + 1) {
+        slots *= 2;
+    }
+    if (slots > SIZE_MAX / 4 / sizeof(_lsa_slot)
+        || a->_next_pos > SIZE_MAX / 4 / sizeof(size_t)
+        || buckets > SIZE_MAX / 4 / sizeof(uint32_t)) {
+        _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
+        return 0;
+    }
+
+    /* scratch space to group the long options by bucket */
+    scratch_size = n * sizeof(_lsa_slot) + (2 * buckets + 1) * sizeof(size_t);
+    order = _lsa_realloc(a, NULL, 0, scratch_size);
+    if (order == NULL) {
+        _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
+        return 0;
+    }
+    bucket_start = (size_t*)(order + n);
+    by_size = bucket_start + buckets + 1;
+    memset(bucket_start, 0, (buckets + 1) * sizeof(size_t));
+    for (i = 0; i < a->_long_index_cap; ++i) {
+        if (a->_long_index[i].arg != 0) {
+            bucket_start[a->_long_index[i].hash % buckets + 1] += 1;
+        }
+    }
+    for (i = 0; i < buckets; ++i) {
+        bucket_start[i + 1] += bucket_start[i];
+    }
+    /* filling advances each start to the start of the next bucket, so shift
+     * them back afterwards */
+    for (i = 0; i < a->_long_index_cap; ++i) {
+        if (a->_long_index[i].arg != 0) {
+            size_t b = a->_long_index[i].hash % buckets;
+            order[bucket_start[b]++] = a->_long_index[i];
+        }
+    }
+    for (i = buckets; i > 0; --i) {
+        bucket_start[i] = bucket_start[i - 1];
+    }
+    bucket_start[0] = 0;
+    /* sort the buckets by size, largest first; insertion sort is fine since
+     * almost all buckets are tiny */
+    for (i = 0; i < buckets; ++i) {
+        size_t size_i = bucket_start[i + 1] - bucket_start[i];
+        for (k = i; k > 0; --k) {
+            size_t prev = by_size[k - 1];
+            if (bucket_start[prev + 1] - bucket_start[prev] >= size_i) {
+                break;
+            }
+            by_size[k] = prev;
+        }
+        by_size[k] = i;
+    }
+
+    header = sizeof(*c);
+    size = header + slots * sizeof(_lsa_slot) + a->_next_pos * sizeof(size_t)
+        + buckets * sizeof(uint32_t);
+    c = _lsa_realloc(a, NULL, 0, size);
+    if (c == NULL) {
+        _lsa_free(a, order, scratch_size);
+        _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
+        return 0;
+    }
+    c->slots = (_lsa_slot*)((char*)c + header);
+    c->pos_index = (size_t*)(c->slots + slots);
+    c->disp = (uint32_t*)(c->pos_index + a->_next_pos);
+    /* placing skips empty buckets, and lookups of unknown names still read
+     * their displacement */
+    memset(c->disp, 0, buckets * sizeof(*c->disp));
+    c->buckets = buckets;
+    c->mask = slots - 1;
+    c->size = size;
+    placed = _lsa_compile_place(c, order, bucket_start, by_size);
+    _lsa_free(a, order, scratch_size);
+    if (!placed) {
+        /* only happens if distinct names have the same 32-bit hash; the open
+         * addressing index still works, so just keep using that */
+        _lsa_free(a, c, size);
+        ls_args_freeze(a);
+        return 1;
+    }
+    if (a->_next_pos > 0) {
+        memcpy(c->pos_index, a->_pos_index, a->_next_pos * sizeof(size_t));
+    }
+    _lsa_free(
+        a, a->_long_index, a->_long_index_cap * sizeof(*a->_long_index));
+    a->_long_index = NULL;
+    a->_long_index_cap = 0;
+    _lsa_free(a, a->_pos_index, a->_pos_cap * sizeof(*a->_pos_index));
+    a->_pos_index = c->pos_index;
+    a->_pos_cap = 0;
+    a->_compiled = c;
+    ls_args_freeze(a);
+    return 1;
+}
+
+int ls_args_use_array(ls_args* a, const ls_args_arg* args, size_t len) {
+    size_t i;
+    assert(a != NULL);
+    assert(args != NULL || len == 0);
+    assert(a->args_len == 0);
+    /* the found bits and short options live in `a` */
+    if (len > LS_ARGS_ARRAY_MAX) {
+        _lsa_set_error_code(a, LS_ARGS_ERR_TOO_MANY);
+        return 0;
+    }
+    /* never written, since nothing can be registered */
+    a->args = (ls_args_arg*)args;
+    a->args_len = len;
+    a->_borrowed = 1;
+#ifdef LS_ARGS_NO_SHORT_TABLE
+    a->_shorts = a->_array_shorts;
+#endif
+    /* one pass for the short options and counts, which live in `a` */
+    for (i = 0; i < len; ++i) {
+        const ls_args_arg* arg = &args[i];
+        if (arg->is_pos) {
+            a->_next_pos += 1;
+#ifdef LS_ARGS_NO_SHORT_TABLE
+        } else if (arg->short_opt != NULL) {
+            a->_array_shorts[i] = (unsigned char)*arg->short_opt;
+#else
+        } else if (arg->short_opt != NULL
+            && a->_short_index[(unsigned char)*arg->short_opt] == 0) {
+            a->_short_index[(unsigned char)*arg->short_opt] = i + 1;
+#endif
+        }
+        if (arg->mode == LS_ARGS_REQUIRED) {
+            a->_required_count += 1;
+        }
+    }
+    ls_args_freeze(a);
+    return 1;
+}
+
+int ls_args_use_table(ls_args* a, const ls_args_table* t) {
+    assert(a != NULL);
+    assert(t != NULL);
+    assert(a->args_len == 0);
+    /* the found bits are per `ls_args`, so that the table can be shared */
+    if (t->args_len > LS_ARGS_ARRAY_MAX) {
+        size_t words = _lsa_WORDS(t->args_len);
+        a->_found = _lsa_realloc(a, NULL, 0, words * sizeof(*a->_found));
+        if (a->_found == NULL) {
+            _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
+            return 0;
+        }
+        a->_found_words = words;
+    }
+    /* never written, since nothing can be registered */
+    a->args = (ls_args_arg*)t->args;
+    a->args_len = t->args_len;
+    a->_pos_index = (size_t*)t->pos_index;
+    a->_next_pos = t->pos_len;
+    a->_required_count = t->required_count;
+    a->_borrowed = 1;
+    a->_table = t;
+    ls_args_freeze(a);
+    return 1;
+}
+
+int ls_args_ctx_init(ls_args_ctx* ctx, const ls_args* spec, void* values,
+    const void* layout) {
+    size_t n = spec->args_len;
+    assert(spec->_frozen);
+    /* either both or neither */
+    assert((values == NULL) == (layout == NULL));
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->spec = spec;
+    ctx->last_error = "Success";
+    ctx->error.argv_index = -1;
+    ctx->error.arg_index = -1;
+    ctx->_values = (char*)values;
+    ctx->_layout = (const char*)layout;
+    if (n > 0) {
+        ctx->_stamps = _lsa_realloc(spec, NULL, 0, n * sizeof(*ctx->_stamps));
+        if (ctx->_stamps == NULL) {
+            _lsa_fail(&ctx->error, LS_ARGS_ERR_ALLOC, -1, -1, NULL, 0);
+            ctx->last_error = _lsa_ALLOC_FAIL_STR;
+            return 0;
+        }
+        memset(ctx->_stamps, 0, n * sizeof(*ctx->_stamps));
+    }
+    return 1;
+}
+
+/* Moves on to the next epoch, which finds no argument until it's marked */
+static void _lsa_ctx_next_epoch(ls_args_ctx* ctx) {
+    ctx->_epoch += 1;
+    /* after wrapping around, stamps of long ago would match again */
+    if (ctx->_epoch == 0) {
+        if (ctx->spec->args_len > 0) {
+            memset(ctx->_stamps, 0,
+                ctx->spec->args_len * sizeof(*ctx->_stamps));
+        }
+        ctx->_epoch = 1;
+    }
+}
+
+void ls_args_ctx_reset(ls_args_ctx* ctx) {
+    assert(ctx != NULL);
+    _lsa_ctx_next_epoch(ctx);
+    _lsa_fail(&ctx->error, LS_ARGS_OK, -1, -1, NULL, 0);
+    ctx->last_error = "Success";
+    ctx->_error_formatted = 0;
+    ctx->program_name = NULL;
+}
+
+int ls_args_ctx_parse(ls_args_ctx* ctx, int argc, char** argv) {
+    return ls_args_ctx_parse_events(ctx, argc, argv, NULL);
+}
+
+int ls_args_ctx_parse_events(ls_args_ctx* ctx, int argc, char** argv,
+    const ls_args_events* events) {
+    _lsa_state st;
+    int ok;
+    assert(ctx != NULL);
+    assert(argv != NULL);
+    ctx->program_name = argv[0];
+    _lsa_state_init(&st, ctx->spec, &ctx->error, NULL);
+    _lsa_ctx_next_epoch(ctx);
+    st.stamps = ctx->_stamps;
+    st.epoch = ctx->_epoch;
+    st.base = ctx->_values;
+    st.layout = ctx->_layout;
+    st.events = events;
+    ok = _lsa_parse_argv(&st, argc, argv);
+    if (ok) {
+        _lsa_fail(&ctx->error, LS_ARGS_OK, -1, -1, NULL, 0);
+    }
+    ctx->last_error = (char*)_lsa_error_summary(ctx->error.code);
+    ctx->_error_formatted = 0;
+    if (!ok) {
+        _lsa_report_error(events, &ctx->error);
+    }
+    return ok;
+}
+
+int ls_args_validate(
+    const ls_args* spec, int argc, char** argv, ls_args_error_info* error) {
+    /* no callbacks, so the loop only checks */
+    static const ls_args_events none = { NULL, NULL, NULL, NULL, NULL };
+    unsigned long found[_lsa_WORDS(LS_ARGS_VALIDATE_MAX)];
+    _lsa_state st;
+    assert(spec != NULL && spec->_frozen);
+    assert(argv != NULL && error != NULL);
+    if (spec->args_len > LS_ARGS_VALIDATE_MAX) {
+        return _lsa_fail(error, LS_ARGS_ERR_TOO_MANY, -1, -1, NULL, 0);
+    }
+    _lsa_state_init(&st, spec, error, found);
+    st.events = &none;
+    if (!_lsa_parse_argv(&st, argc, argv)) {
+        return 0;
+    }
+    _lsa_fail(error, LS_ARGS_OK, -1, -1, NULL, 0);
+    return 1;
+}
+
+void ls_args_format_error(const ls_args* spec, const ls_args_error_info* error,
+    char buf[LS_ARGS_ERROR_MAX]) {
+    _lsa_format_error(spec, error, buf);
+}
+
+/* Fails the parse with the context before it started */
+static int _lsa_ctx_fail(ls_args_ctx* ctx, ls_args_error_code code,
+    int argv_index, const char* token) {
+    _lsa_fail(&ctx->error, code, argv_index, -1, token, 0);
+    ctx->program_name = NULL;
+    ctx->last_error = (char*)_lsa_error_summary(code);
+    ctx->_error_formatted = 0;
+    return 0;
+}
+
+typedef enum _lsa_split_type {
+    _lsa_SPLIT_END = 0,
+    _lsa_SPLIT_WORD = 1,
+    /* a word with a quote that isn't closed */
+    _lsa_SPLIT_OPEN_QUOTE = 2
+} _lsa_split_type;
+
+static int _lsa_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v'
+        || c == '\f';
+}
+
+/* Finds the next whitespace separated word from `*p` on, before `end`. With
+ * `quotes`, '...' and "..." group, and a backslash escapes the next byte
+ * outside of single quotes. Quotes are removed in place by moving the rest of
+ * the word forward, so a word never grows: it's from `*word` to `*word_end`,
+ * which is before the separator that follows, or at `end`. The word isn't
+ * terminated, and only bytes that change are written. `*p` is moved past the
+ * separator. */
+static _lsa_split_type _lsa_split_word(
+    char** p, char* end, int quotes, char** word, char** word_end) {
+    char* r = *p;
+    char* w;
+    char quote = 0;
+    while (r < end && _lsa_is_space(*r)) {
+        ++r;
+    }
+    if (r == end) {
+        *p = r;
+        return _lsa_SPLIT_END;
+    }
+    *word = w = r;
+    while (r < end && (quote != 0 || !_lsa_is_space(*r))) {
+        char c = *r++;
+        if (quotes) {
+            if (quote == 0 && (c == '\'' || c == '"')) {
+                quote = c;
+                continue;
+            }
+            if (c == quote) {
+                quote = 0;
+                continue;
+            }
+            if (c == '\\' && quote != '\'' && r < end) {
+                c = *r++;
+            }
+        }
+        if (w != r - 1) {
+            *w = c;
+        }
+        ++w;
+    }
+    *word_end = w;
+    /* past the separator, which `w` can't be past */
+    *p = r < end ? r + 1 : r;
+    return quote != 0 ? _lsa_SPLIT_OPEN_QUOTE : _lsa_SPLIT_WORD;
+}
+
+/* Splits `s` into at most `max` words, see `ls_args_split`. Returns the
+ * number of words, or -1 with the error in `err` */
+static int _lsa_split(char* s, char** argv, int max, ls_args_error_info* err) {
+    char* p = s;
+    char* end = s + strlen(s);
+    int argc = 0;
+    for (;;) {
+        char* word;
+        char* word_end;
+        _lsa_split_type type = _lsa_split_word(&p, end, 1, &word, &word_end);
+        if (type == _lsa_SPLIT_END) {
+            return argc;
+        }
+        /* at most at the terminator of `s` */
+        *word_end = '\0';
+        if (type == _lsa_SPLIT_OPEN_QUOTE) {
+            _lsa_fail(err, LS_ARGS_ERR_INVALID, argc, -1, word, 0);
+            return -1;
+        }
+        if (argc == max) {
+            _lsa_fail(err, LS_ARGS_ERR_UNEXPECTED, argc, -1, word, 0);
+            return -1;
+        }
+        argv[argc++] = word;
+    }
+}
+
+int ls_args_split(char* s, char** argv, int max) {
+    ls_args_error_info err;
+    assert(s != NULL);
+    assert(argv != NULL || max == 0);
+    return _lsa_split(s, argv, max, &err);
+}
+
+int ls_args_parse_string(ls_args* a, char* s, char** argv, int max) {
+    int argc;
+    assert(a != NULL);
+    argc = _lsa_split(s, argv, max, &a->error);
+    if (argc < 0) {
+        a->program_name = NULL;
+        a->last_error = (char*)_lsa_error_summary(a->error.code);
+        a->_error_formatted = 0;
+        return 0;
+    }
+    if (argc == 0) {
+        char* none = NULL;
+        return ls_args_parse(a, 0, &none);
+    }
+    return ls_args_parse(a, argc, argv);
+}
+
+/* Appends `arg` to the argv the context keeps, of which `*argc` entries are
+ * in use, and keeps it NULL-terminated. 0 on allocation failure */
+static int _lsa_ctx_push(ls_args_ctx* ctx, size_t* argc, char* arg) {
+    /* one more for the terminating NULL, like argv has */
+    if (*argc + 2 > ctx->_argv_cap) {
+        char** new_argv;
+        size_t new_cap = ctx->_argv_cap + ctx->_argv_cap / 2 + 16;
+        if (new_cap > (size_t)INT_MAX
+            || new_cap > SIZE_MAX / sizeof(*new_argv)) {
+            return 0;
+        }
+        new_argv = _lsa_realloc(ctx->spec, ctx->_argv,
+            ctx->_argv_cap * sizeof(*new_argv), new_cap * sizeof(*new_argv));
+        if (new_argv == NULL) {
+            return 0;
+        }
+        ctx->_argv = new_argv;
+        ctx->_argv_cap = new_cap;
+    }
+    ctx->_argv[(*argc)++] = arg;
+    ctx->_argv[*argc] = NULL;
+    return 1;
+}
+
+/* `ls_args_ctx_parse_buffer`, with `events` like `ls_args_ctx_parse_events` */
+static int _lsa_ctx_parse_buffer(ls_args_ctx* ctx, char* buf, size_t len,
+    const ls_args_events* events) {
+    char* p = buf;
+    char* end = buf + len;
+    size_t argc = 0;
+    char* none = NULL;
+    while (p < end) {
+        char* nul = memchr(p, '\0', (size_t)(end - p));
+        if (nul == NULL) {
+            /* can't be handed out as a string without writing past the end */
+            return _lsa_ctx_fail(ctx, LS_ARGS_ERR_INVALID, (int)argc, "");
+        }
+        if (!_lsa_ctx_push(ctx, &argc, p)) {
+            return _lsa_ctx_fail(ctx, LS_ARGS_ERR_ALLOC, -1, NULL);
+        }
+        p = nul + 1;
+    }
+    if (argc == 0) {
+        /* like a process without a command line */
+        return ls_args_ctx_parse_events(ctx, 0, &none, events);
+    }
+    return ls_args_ctx_parse_events(ctx, (int)argc, ctx->_argv, events);
+}
+
+int ls_args_ctx_parse_buffer(ls_args_ctx* ctx, char* buf, size_t len) {
+    assert(ctx != NULL);
+    assert(buf != NULL || len == 0);
+    return _lsa_ctx_parse_buffer(ctx, buf, len, NULL);
+}
+
+#ifdef LS_ARGS_POSIX
+/* A mapped response file, or the copy of its last argument, see
+ * `_lsa_response_split` */
+struct _lsa_mapping {
+    void* addr;
+    size_t len;
+    int heap;
+};
+
+/* Releases the response files of the last parse */
+static void _lsa_ctx_unmap(ls_args_ctx* ctx) {
+    size_t i;
+    for (i = 0; i < ctx->_maps_len; ++i) {
+        struct _lsa_mapping* m = &ctx->_maps[i];
+        if (m->heap) {
+            _lsa_free(ctx->spec, m->addr, m->len);
+        } else {
+            munmap(m->addr, m->len);
+        }
+    }
+    ctx->_maps_len = 0;
+}
+
+/* Remembers a mapping or a heap block to release with the others. 0 on
+ * allocation failure */
+static int _lsa_ctx_keep(ls_args_ctx* ctx, void* addr, size_t len, int heap) {
+    if (ctx->_maps_len + 1 > ctx->_maps_cap) {
+        struct _lsa_mapping* new_maps;
+        size_t new_cap = ctx->_maps_cap * 2 + 4;
+        if (new_cap > SIZE_MAX / sizeof(*new_maps)) {
+            return 0;
+        }
+        new_maps = _lsa_realloc(ctx->spec, ctx->_maps,
+            ctx->_maps_cap * sizeof(*new_maps), new_cap * sizeof(*new_maps));
+        if (new_maps == NULL) {
+            return 0;
+        }
+        ctx->_maps = new_maps;
+        ctx->_maps_cap = new_cap;
+    }
+    ctx->_maps[ctx->_maps_len].addr = addr;
+    ctx->_maps[ctx->_maps_len].len = len;
+    ctx->_maps[ctx->_maps_len].heap = heap;
+    ctx->_maps_len += 1;
+    return 1;
+}
+
+/* One `ls_args_ctx_parse_response` */
+typedef struct _lsa_response {
+    ls_args_ctx* ctx;
+    int flags;
+    /* arguments in the argv of the context so far */
+    size_t argc;
+    /* why it failed, and in which file */
+    ls_args_error_code code;
+    const char* path;
+} _lsa_response;
+
+static int _lsa_response_fail(
+    _lsa_response* r, ls_args_error_code code, const char* path) {
+    r->code = code;
+    r->path = path;
+    return 0;
+}
+
+static int _lsa_response_file(_lsa_response* r, const char* path, int depth);
+
+/* Adds `arg` to the arguments, or the arguments of the file it names */
+static int _lsa_expand(_lsa_response* r, char* arg, int depth) {
+    if (arg[0] != '@' || arg[1] == '\0') {
+        if (!_lsa_ctx_push(r->ctx, &r->argc, arg)) {
+            return _lsa_response_fail(r, LS_ARGS_ERR_ALLOC, NULL);
+        }
+        return 1;
+    }
+    if (depth == LS_ARGS_RESPONSE_DEPTH) {
+        errno = ELOOP;
+        return _lsa_response_fail(r, LS_ARGS_ERR_RESPONSE, arg + 1);
+    }
+    return _lsa_response_file(r, arg + 1, depth + 1);
+}
+
+/* Splits the `size` bytes of the file `path` mapped at `base` into arguments,
+ * in place, and expands each of them. Separators become NUL bytes. Only bytes
+ * that change are written, so pages stay shared with the file where possible.
+ */
+static int _lsa_response_split(
+    _lsa_response* r, char* base, size_t size, const char* path, int depth) {
+    char* p = base;
+    char* end = base + size;
+    while (p < end) {
+        char* arg;
+        char* w;
+        if (r->flags & LS_ARGS_RESPONSE_NUL) {
+            arg = p;
+            w = memchr(p, '\0', (size_t)(end - p));
+            if (w == NULL) {
+                w = end;
+            }
+            p = w < end ? w + 1 : end;
+        } else {
+            _lsa_split_type type = _lsa_split_word(
+                &p, end, r->flags & LS_ARGS_RESPONSE_QUOTES, &arg, &w);
+            if (type == _lsa_SPLIT_END) {
+                break;
+            }
+            if (type == _lsa_SPLIT_OPEN_QUOTE) {
+                errno = EINVAL;
+                return _lsa_response_fail(r, LS_ARGS_ERR_RESPONSE, path);
+            }
+        }
+        if (w < end) {
+            if (*w != '\0') {
+                *w = '\0';
+            }
+        } else if (size % (size_t)sysconf(_SC_PAGESIZE) == 0) {
+            /* The last argument runs up to the end of the file. Usually, the
+             * rest of the last page reads as zeros and terminates it, but
+             * here the file ends with the page, so it's copied. */
+            size_t len = (size_t)(end - arg);
+            char* copy = _lsa_realloc(r->ctx->spec, NULL, 0, len + 1);
+            if (copy == NULL) {
+                return _lsa_response_fail(r, LS_ARGS_ERR_ALLOC, NULL);
+            }
+            memcpy(copy, arg, len);
+            copy[len] = '\0';
+            if (!_lsa_ctx_keep(r->ctx, copy, len + 1, 1)) {
+                _lsa_free(r->ctx->spec, copy, len + 1);
+                return _lsa_response_fail(r, LS_ARGS_ERR_ALLOC, NULL);
+            }
+            arg = copy;
+        }
+        if (!_lsa_expand(r, arg, depth)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int _lsa_response_file(_lsa_response* r, const char* path, int depth) {
+    struct stat st;
+    void* base;
+    size_t size;
+    int saved;
+    /* non-blocking, so that opening a FIFO without a writer fails below
+     * instead of waiting */
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        return _lsa_response_fail(r, LS_ARGS_ERR_RESPONSE, path);
+    }
+    if (fstat(fd, &st) != 0) {
+        saved = errno;
+        close(fd);
+        errno = saved;
+        return _lsa_response_fail(r, LS_ARGS_ERR_RESPONSE, path);
+    }
+    /* a pipe or device has no size to map, and would look empty */
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = EINVAL;
+        return _lsa_response_fail(r, LS_ARGS_ERR_RESPONSE, path);
+    }
+    size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return 1;
+    }
+    if ((off_t)size != st.st_size) {
+        close(fd);
+        errno = EFBIG;
+        return _lsa_response_fail(r, LS_ARGS_ERR_RESPONSE, path);
+    }
+    /* private, so that splitting never writes to the file */
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    saved = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        errno = saved;
+        return _lsa_response_fail(r, LS_ARGS_ERR_RESPONSE, path);
+    }
+    if (!_lsa_ctx_keep(r->ctx, base, size, 0)) {
+        munmap(base, size);
+        return _lsa_response_fail(r, LS_ARGS_ERR_ALLOC, NULL);
+    }
+    return _lsa_response_split(r, (char*)base, size, path, depth);
+}
+
+int ls_args_ctx_parse_response(
+    ls_args_ctx* ctx, int argc, char** argv, int flags) {
+    _lsa_response r;
+    char* none = NULL;
+    int i;
+    assert(ctx != NULL);
+    assert(argv != NULL);
+    _lsa_ctx_unmap(ctx);
+    r.ctx = ctx;
+    r.flags = flags;
+    r.argc = 0;
+    r.code = LS_ARGS_OK;
+    r.path = NULL;
+    for (i = 0; i < argc; ++i) {
+        /* the program name is never a response file */
+        int ok = i == 0 ? _lsa_ctx_push(ctx, &r.argc, argv[0])
+                        : _lsa_expand(&r, argv[i], 0);
+        if (!ok) {
+            if (i == 0) {
+                r.code = LS_ARGS_ERR_ALLOC;
+            }
+            return _lsa_ctx_fail(ctx, r.code, (int)r.argc, r.path);
+        }
+    }
+    if (r.argc == 0) {
+        return ls_args_ctx_parse(ctx, 0, &none);
+    }
+    return ls_args_ctx_parse(ctx, (int)r.argc, ctx->_argv);
+}
+#endif
+
+const char* ls_args_ctx_error(ls_args_ctx* ctx) {
+    if (!ctx->_error_formatted) {
+        _lsa_format_error(ctx->spec, &ctx->error, ctx->_error_buf);
+        ctx->_error_formatted = 1;
+    }
+    return ctx->_error_buf;
+}
+
+void ls_args_ctx_free(ls_args_ctx* ctx) {
+    if (ctx) {
+        _lsa_free(ctx->spec, ctx->_stamps,
+            ctx->spec->args_len * sizeof(*ctx->_stamps));
+        ctx->_stamps = NULL;
+        _lsa_free(ctx->spec, ctx->_argv, ctx->_argv_cap * sizeof(*ctx->_argv));
+        ctx->_argv = NULL;
+        ctx->_argv_cap = 0;
+#ifdef LS_ARGS_POSIX
+        _lsa_ctx_unmap(ctx);
+        _lsa_free(ctx->spec, ctx->_maps, ctx->_maps_cap * sizeof(*ctx->_maps));
+        ctx->_maps = NULL;
+        ctx->_maps_cap = 0;
+#endif
+    }
+}
+
+#ifdef LS_ARGS_PTHREAD
+struct _lsa_batch;
+
+/* One thread of `ls_args_parse_batch`, with the records it has left */
+typedef struct _lsa_batch_worker {
+    struct _lsa_batch* batch;
+    pthread_t thread;
+    int started;
+    /* guards `begin` and `end`, which thieves take from */
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+    ls_args_ctx ctx;
+    ls_args_events events;
+    /* the `bound` entries of the record being parsed, or NULL */
+    int* row;
+} _lsa_batch_worker;
+
+typedef struct _lsa_batch {
+    const ls_args* spec;
+    const ls_args_batch_input* inputs;
+    ls_args_batch_result* results;
+    int* bound;
+    _lsa_batch_worker* workers;
+    size_t workers_len;
+} _lsa_batch;
+
+static int _lsa_batch_option(
+    void* user, const ls_args_arg* arg, long arg_index, int argv_index) {
+    _lsa_batch_worker* w = user;
+    if (w->row != NULL && arg->type == LS_ARGS_TYPE_BOOL) {
+        w->row[arg_index] = argv_index;
+    }
+    return 1;
+}
+
+static int _lsa_batch_value(void* user, const ls_args_arg* arg,
+    long arg_index, const char* value, int argv_index) {
+    _lsa_batch_worker* w = user;
+    (void)value;
+    /* the first value of a rest argument, the last of anything else */
+    if (w->row != NULL
+        && (arg->type != LS_ARGS_TYPE_REST || w->row[arg_index] < 0)) {
+        w->row[arg_index] = argv_index;
+    }
+    return 1;
+}
+
+/* Takes the next chunk of records of `w`. If it has none left, steals half of
+ * what another worker has left, and tries again. Never holds two locks at
+ * once. Returns 0 once all workers have run out. */
+static int _lsa_batch_claim(_lsa_batch_worker* w, size_t* begin, size_t* end) {
+    _lsa_batch* b = w->batch;
+    size_t self = (size_t)(w - b->workers);
+    for (;;) {
+        size_t k;
+        int stolen = 0;
+        pthread_mutex_lock(&w->lock);
+        if (w->begin < w->end) {
+            *begin = w->begin;
+            *end = w->end - w->begin > LS_ARGS_BATCH_CHUNK
+                ? w->begin + LS_ARGS_BATCH_CHUNK
+                : w->end;
+            w->begin = *end;
+            pthread_mutex_unlock(&w->lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&w->lock);
+        /* start with the next one, so that thieves spread out */
+        for (k = 1; k < b->workers_len && !stolen; ++k) {
+            _lsa_batch_worker* v = &b->workers[(self + k) % b->workers_len];
+            size_t take, from = 0;
+            pthread_mutex_lock(&v->lock);
+            take = (v->end - v->begin + 1) / 2;
+            if (take > 0) {
+                /* from the back, which the owner gets to last */
+                v->end -= take;
+                from = v->end;
+                stolen = 1;
+            }
+            pthread_mutex_unlock(&v->lock);
+            if (stolen) {
+                pthread_mutex_lock(&w->lock);
+                w->begin = from;
+                w->end = from + take;
+                pthread_mutex_unlock(&w->lock);
+            }
+        }
+        if (!stolen) {
+            return 0;
+        }
+    }
+}
+
+static void* _lsa_batch_run(void* user) {
+    _lsa_batch_worker* w = user;
+    _lsa_batch* b = w->batch;
+    size_t begin, end, i;
+    while (_lsa_batch_claim(w, &begin, &end)) {
+        for (i = begin; i < end; ++i) {
+            const ls_args_batch_input* in = &b->inputs[i];
+            ls_args_batch_result* res = &b->results[i];
+            int ok;
+            if (b->bound != NULL) {
+                size_t k;
+                w->row = b->bound + i * b->spec->args_len;
+                for (k = 0; k < b->spec->args_len; ++k) {
+                    w->row[k] = -1;
+                }
+            }
+            if (in->argv != NULL) {
+                ok = ls_args_ctx_parse_events(
+                    &w->ctx, in->argc, in->argv, &w->events);
+            } else {
+                ok = _lsa_ctx_parse_buffer(
+                    &w->ctx, in->record, in->record_len, &w->events);
+            }
+            res->ok = (unsigned char)ok;
+            res->code = (unsigned char)w->ctx.error.code;
+            res->argv_index = w->ctx.error.argv_index;
+            res->arg_index = w->ctx.error.arg_index;
+        }
+    }
+    return NULL;
+}
+
+int ls_args_parse_batch(const ls_args* spec, const ls_args_batch_input* inputs,
+    size_t count, ls_args_batch_result* results, int* bound, int threads) {
+    _lsa_batch b;
+    size_t n, i;
+    int ok = 1;
+    assert(spec != NULL && spec->_frozen);
+    assert(inputs != NULL || count == 0);
+    assert(results != NULL || count == 0);
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int)online : 1;
+    }
+    n = (size_t)threads;
+    if (n > SIZE_MAX / sizeof(*b.workers)) {
+        return 0;
+    }
+    b.spec = spec;
+    b.inputs = inputs;
+    b.results = results;
+    b.bound = bound;
+    b.workers_len = n;
+    b.workers = _lsa_realloc(spec, NULL, 0, n * sizeof(*b.workers));
+    if (b.workers == NULL) {
+        return 0;
+    }
+    for (i = 0; i < n; ++i) {
+        _lsa_batch_worker* w = &b.workers[i];
+        memset(w, 0, sizeof(*w));
+        w->batch = &b;
+        /* equal shares, the first ones get the remainder */
+        w->begin = count / n * i + (i < count % n ? i : count % n);
+        w->end = w->begin + count / n + (i < count % n);
+        w->events.user = w;
+        w->events.option = _lsa_batch_option;
+        w->events.value = _lsa_batch_value;
+        w->events.positional = _lsa_batch_value;
+        pthread_mutex_init(&w->lock, NULL);
+        if (!ls_args_ctx_init(&w->ctx, spec, NULL, NULL)) {
+            ok = 0;
+        }
+    }
+    if (ok) {
+        /* a thread that doesn't start leaves its share to be stolen */
+        for (i = 1; i < n; ++i) {
+            b.workers[i].started = pthread_create(&b.workers[i].thread, NULL,
+                                       _lsa_batch_run, &b.workers[i])
+                == 0;
+        }
+        _lsa_batch_run(&b.workers[0]);
+        for (i = 1; i < n; ++i) {
+            if (b.workers[i].started) {
+                pthread_join(b.workers[i].thread, NULL);
+            }
+        }
+    }
+    for (i = 0; i < n; ++i) {
+        ls_args_ctx_free(&b.workers[i].ctx);
+        pthread_mutex_destroy(&b.workers[i].lock);
+    }
+    _lsa_free(spec, b.workers, n * sizeof(*b.workers));
+    return ok;
+}
+#endif
+
+void ls_args_iter_init(
+    ls_args_iter* it, const ls_args* spec, int argc, char** argv) {
+    assert(it != NULL);
+    assert(spec != NULL);
+    assert(argv != NULL || argc == 0);
+    memset(it, 0, sizeof(*it));
+    it->spec = spec;
+    it->arg_index = -1;
+    it->argv_index = -1;
+    it->error.argv_index = -1;
+    it->error.arg_index = -1;
+    it->_argc = argc;
+    it->_argv = argv;
+    it->_next = 1;
+}
+
+static ls_args_item _lsa_iter_fail(ls_args_iter* it, ls_args_error_code code,
+    int argv_index, long arg_index, const char* token, char short_opt) {
+    _lsa_fail(&it->error, code, argv_index, arg_index, token, short_opt);
+    it->_error_formatted = 0;
+    it->_failed = 1;
+    it->arg = NULL;
+    it->arg_index = -1;
+    it->value = NULL;
+    return LS_ARGS_ITEM_ERROR;
+}
+
+/* Yields the option `arg`, given in `argv[i]`, and takes its value from
+ * `argv[i + 1]` if it needs one. */
+static ls_args_item _lsa_iter_option(
+    ls_args_iter* it, const ls_args_arg* arg, int i) {
+    long k = (long)(arg - it->spec->args);
+    _lsa_number n;
+    ls_args_error_code code;
+    it->arg = arg;
+    it->arg_index = k;
+    it->argv_index = i;
+    if (!_lsa_takes_value(arg)) {
+        return LS_ARGS_ITEM_OPTION;
+    }
+    /* the value must be the next argument, not the rest of a cluster */
+    if (it->_cluster != NULL && *it->_cluster != '\0') {
+        return _lsa_iter_fail(
+            it, LS_ARGS_ERR_MISSING_VALUE, i, k, NULL, *it->_cluster);
+    }
+    if (i + 1 >= it->_argc) {
+        return _lsa_iter_fail(it, LS_ARGS_ERR_MISSING_VALUE, i, k, NULL, 0);
+    }
+    if (_lsa_parse(it->_argv[i + 1]).type != LS_ARGS_PARSED_POSITIONAL
+        && !_lsa_negative_value(arg, it->_argv[i + 1])) {
+        return _lsa_iter_fail(
+            it, LS_ARGS_ERR_MISSING_VALUE, i + 1, k, NULL, 0);
+    }
+    code = _lsa_convert(arg, it->_argv[i + 1], &n);
+    if (code != LS_ARGS_OK) {
+        return _lsa_iter_fail(it, code, i + 1, k, it->_argv[i + 1], 0);
+    }
+    it->value = it->_argv[i + 1];
+    it->_next = i + 2;
+    return LS_ARGS_ITEM_OPTION;
+}
+
+/* Yields the next option of the short option cluster in `argv[i]` */
+static ls_args_item _lsa_iter_short(ls_args_iter* it, int i) {
+    char c = *it->_cluster++;
+    size_t k = _lsa_short_lookup(it->spec, c);
+    if (k == 0) {
+        return _lsa_iter_fail(it, LS_ARGS_ERR_UNKNOWN_SHORT, i, -1, NULL, c);
+    }
+    return _lsa_iter_option(it, &it->spec->args[k - 1], i);
+}
+
+/* Yields `argv[i]` as the next positional */
+static ls_args_item _lsa_iter_positional(ls_args_iter* it, int i) {
+    const ls_args* a = it->spec;
+    const ls_args_arg* arg = it->_pos < a->_next_pos
+        ? _lsa_pos_arg(a, it->_pos)
+        : _lsa_pos_rest(a);
+    if (arg == NULL) {
+        return _lsa_iter_fail(
+            it, LS_ARGS_ERR_UNEXPECTED, i, -1, it->_argv[i], 0);
+    }
+    it->_pos += 1;
+    it->arg = arg;
+    it->arg_index = (long)(arg - a->args);
+    it->argv_index = i;
+    it->value = it->_argv[i];
+    return LS_ARGS_ITEM_POSITIONAL;
+}
+
+ls_args_item ls_args_next(ls_args_iter* it) {
+    const ls_args* a;
+    const ls_args_arg* arg;
+    int i;
+    assert(it != NULL);
+    a = it->spec;
+    if (it->_failed) {
+        return LS_ARGS_ITEM_ERROR;
+    }
+    it->arg = NULL;
+    it->arg_index = -1;
+    it->value = NULL;
+    if (it->_cluster != NULL && *it->_cluster != '\0') {
+        return _lsa_iter_short(it, it->argv_index);
+    }
+    it->_cluster = NULL;
+    while (!it->_stopped && it->_next < it->_argc) {
+        _lsa_parsed parsed;
+        i = it->_next++;
+        parsed = _lsa_parse(it->_argv[i]);
+        switch (parsed.type) {
+        case LS_ARGS_PARSED_ERROR:
+            return _lsa_iter_fail(
+                it, LS_ARGS_ERR_INVALID, i, -1, parsed.as.erroneous, 0);
+        case LS_ARGS_PARSED_LONG:
+            arg = _lsa_long_find(a, parsed.as.long_arg, parsed.long_len);
+            if (arg == NULL) {
+                return _lsa_iter_fail(it, LS_ARGS_ERR_UNKNOWN_LONG, i, -1,
+                    parsed.as.long_arg, 0);
+            }
+            return _lsa_iter_option(it, arg, i);
+        case LS_ARGS_PARSED_SHORT:
+            it->_cluster = parsed.as.short_args;
+            return _lsa_iter_short(it, i);
+        case LS_ARGS_PARSED_STOP:
+            it->_stopped = 1;
+            break;
+        case LS_ARGS_PARSED_POSITIONAL:
+            return _lsa_iter_positional(it, i);
+        }
+    }
+    if (it->_next >= it->_argc) {
+        it->argv_index = -1;
+        return LS_ARGS_ITEM_END;
+    }
+    /* everything after `--` is positional */
+    return _lsa_iter_positional(it, it->_next++);
+}
+
+const char* ls_args_iter_error(ls_args_iter* it) {
+    if (!it->_error_formatted) {
+        _lsa_format_error(it->spec, &it->error, it->_error_buf);
+        it->_error_formatted = 1;
+    }
+    return it->_error_buf;
+}
+
+typedef struct _lsa_buffer {
+    const ls_args* a;
+    char* data;
+    size_t length;
+    size_t capacity;
+} _lsa_buffer;
+
+static int _lsa_buffer_reserve(_lsa_buffer* buffer, size_t required_capacity) {
+    char* new_data;
+    size_t new_capacity;
+
+    if (required_capacity <= buffer->capacity)
+        return 1;
+
+    /* grow geometrically, so that appending piece by piece stays linear */
+    new_capacity = buffer->capacity + buffer->capacity / 2;
+    if (new_capacity < required_capacity)
+        new_capacity = required_capacity;
+
+    new_data = (char*)_lsa_realloc(
+        buffer->a, buffer->data, buffer->capacity, new_capacity);
+    if (!new_data)
+        return 0;
+
+    buffer->data = new_data;
+    buffer->capacity = new_capacity;
+    return 1;
+}
+
+static int _lsa_buffer_append_bytes(
+    _lsa_buffer* buffer, const void* source, size_t byte_count) {
+    if (!_lsa_buffer_reserve(buffer, buffer->length + byte_count + 1)) {
+        return 0;
+    }
+
+    memcpy(buffer->data + buffer->length, source, byte_count);
+
+    buffer->length += byte_count;
+    buffer->data[buffer->length] = '\0';
+    return 1;
+}
+
+/* Receives the help text piece by piece. Returns 0 to stop rendering. */
+typedef int (*_lsa_emit_fn)(void* user, const char* s, size_t len);
+
+static int _lsa_emit_cstr(_lsa_emit_fn emit, void* user, const char* s) {
+    /* the help string of an argument may be NULL */
+    if (s == NULL)
+        return 1;
+    return emit(user, s, strlen(s));
+}
+
+static int _lsa_emit_measure(void* user, const char* s, size_t len) {
+    (void)s;
+    *(size_t*)user += len;
+    return 1;
+}
+
+static int _lsa_emit_buffer(void* user, const char* s, size_t len) {
+    return _lsa_buffer_append_bytes((_lsa_buffer*)user, s, len);
+}
+
+/* Produces the help text as a sequence of pieces, all of which are either
+ * string literals or strings owned by the caller. Returns 0 if `emit` did. */
+static int _lsa_help_render(const ls_args* a, _lsa_emit_fn emit, void* user) {
+    size_t i;
+    int has_nonpositional = 0;
+
+    if (!_lsa_emit_cstr(emit, user, "Usage: "))
+        return 0;
+    if (!_lsa_emit_cstr(emit, user, a->program_name))
+        return 0;
+    if (a->args_len == 0)
+        return 1;
+
+    for (i = 0; i < a->args_len; ++i) {
+        if (!a->args[i].is_pos) {
+            has_nonpositional = 1;
+            break;
+        }
+    }
+    if (has_nonpositional && !_lsa_emit_cstr(emit, user, " [OPTION]"))
+        return 0;
+    for (i = 0; i < a->args_len; ++i) {
+        const ls_args_arg* arg = &a->args[i];
+        int required = arg->mode == LS_ARGS_REQUIRED;
+        if (!arg->is_pos) {
+            continue;
+        }
+        if (!_lsa_emit_cstr(emit, user, required ? " <" : " ["))
+            return 0;
+        if (!_lsa_emit_cstr(emit, user, arg->help))
+            return 0;
+        if (arg->type == LS_ARGS_TYPE_REST
+            && !_lsa_emit_cstr(emit, user, "..."))
+            return 0;
+        if (!_lsa_emit_cstr(emit, user, required ? ">" : "]"))
+            return 0;
+    }
+    if (a->help_description) {
+        if (!_lsa_emit_cstr(emit, user, "\n\n"))
+            return 0;
+        if (!_lsa_emit_cstr(emit, user, a->help_description))
+            return 0;
+    }
+
+    /* Only print "Options:" if there are non-positional options */
+    if (!has_nonpositional)
+        return 1;
+    if (!_lsa_emit_cstr(emit, user, "\n\nOptions:"))
+        return 0;
+    for (i = 0; i < a->args_len; ++i) {
+        const ls_args_arg* arg = &a->args[i];
+        const char* value;
+        if (arg->is_pos) {
+            continue;
+        }
+        if (arg->type == LS_ARGS_TYPE_BOOL) {
+            value = " \t\t\t";
+        } else if (arg->mode == LS_ARGS_REQUIRED) {
+            value = " \t<VALUE> \t";
+        } else {
+            value = " \t[VALUE] \t";
+        }
+        if (!_lsa_emit_cstr(emit, user, "\n  -"))
+            return 0;
+        if (!_lsa_emit_cstr(emit, user, arg->short_opt))
+            return 0;
+        if (!_lsa_emit_cstr(emit, user, " \t--"))
+            return 0;
+        if (!_lsa_emit_cstr(emit, user, arg->long_opt))
+            return 0;
+        if (!_lsa_emit_cstr(emit, user, value))
+            return 0;
+        if (!_lsa_emit_cstr(emit, user, arg->help))
+            return 0;
+    }
+    return 1;
+}
+
+char* ls_args_help(ls_args* a) {
+    _lsa_buffer help;
+    size_t size = 0;
+    if (a->_allocated_help != NULL) {
+        _lsa_free(a, a->_allocated_help, a->_allocated_help_size);
+        a->_allocated_help = NULL;
+        a->_allocated_help_size = 0;
+    }
+    help.a = a;
+    help.data = NULL;
+    help.length = 0;
+    help.capacity = 0;
+
+    if (a->program_name == NULL) {
+        a->program_name = "<program>";
+    }
+    /* measure first, so that the text is built with a single allocation */
+    _lsa_help_render(a, _lsa_emit_measure, &size);
+    if (size == SIZE_MAX || !_lsa_buffer_reserve(&help, size + 1)) {
+        goto alloc_fail;
+    }
+    if (!_lsa_help_render(a, _lsa_emit_buffer, &help)) {
+        goto alloc_fail;
+    }
+    a->_allocated_help = help.data;
+    a->_allocated_help_size = help.capacity;
+    _lsa_set_error_code(a, LS_ARGS_OK);
+    return a->_allocated_help;
+alloc_fail:
+    a->_allocated_help = help.data;
+    a->_allocated_help_size = help.capacity;
+    _lsa_set_error_code(a, LS_ARGS_ERR_ALLOC);
+    return "Not enough memory available to generate help text.";
+}
+
+typedef struct _lsa_iov_batch {
+    ls_args_iovec iov[LS_ARGS_IOV_BATCH];
+    size_t count;
+    ls_args_sink sink;
+    void* user;
+} _lsa_iov_batch;
+
+static int _lsa_iov_flush(_lsa_iov_batch* batch) {
+    size_t count = batch->count;
+    batch->count = 0;
+    return count == 0 || batch->sink(batch->user, batch->iov, count);
+}
+
+static int _lsa_emit_iov(void* user, const char* s, size_t len) {
+    _lsa_iov_batch* batch = (_lsa_iov_batch*)user;
+    if (len == 0)
+        return 1;
+    if (batch->count == LS_ARGS_IOV_BATCH && !_lsa_iov_flush(batch))
+        return 0;
+    batch->iov[batch->count].base = s;
+    batch->iov[batch->count].len = len;
+    batch->count += 1;
+    return 1;
+}
+
+int ls_args_help_stream(ls_args* a, ls_args_sink sink, void* user) {
+    _lsa_iov_batch batch;
+    assert(sink != NULL);
+    batch.count = 0;
+    batch.sink = sink;
+    batch.user = user;
+    if (a->program_name == NULL) {
+        a->program_name = "<program>";
+    }
+    return _lsa_help_render(a, _lsa_emit_iov, &batch) && _lsa_iov_flush(&batch);
+}
+
+#ifdef LS_ARGS_POSIX
+static int _lsa_sink_fd(void* user, const ls_args_iovec* iov, size_t count) {
+    int fd = *(int*)user;
+    struct iovec vec[LS_ARGS_IOV_BATCH];
+    size_t first = 0;
+    size_t i;
+    assert(count <= LS_ARGS_IOV_BATCH);
+    for (i = 0; i < count; ++i) {
+        vec[i].iov_base = (void*)iov[i].base;
+        vec[i].iov_len = iov[i].len;
+    }
+    while (first < count) {
+        ssize_t written = writev(fd, &vec[first], (int)(count - first));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return 0;
+        }
+        /* skip what was written, which may end in the middle of a piece */
+        while (first < count && (size_t)written >= vec[first].iov_len) {
+            written -= (ssize_t)vec[first].iov_len;
+            first += 1;
+        }
+        if (first < count) {
+            vec[first].iov_base = (char*)vec[first].iov_base + written;
+            vec[first].iov_len -= (size_t)written;
+        }
+    }
+    return 1;
+}
+
+int ls_args_help_fd(ls_args* a, int fd) {
+    return ls_args_help_stream(a, _lsa_sink_fd, &fd);
+}
+
+/* Hands the positional `value`, read from the stream, to the events */
+static int _lsa_stream_emit(ls_args* a, const ls_args_events* events,
+    const ls_args_arg* rest, char* value) {
+    long k;
+    if (rest == NULL) {
+        return _lsa_fail(&a->error, LS_ARGS_ERR_UNEXPECTED, -1, -1, value, 0);
+    }
+    k = (long)(rest - a->args);
+    if (events->positional != NULL
+        && !events->positional(events->user, rest, k, value, -1)) {
+        return _lsa_fail(&a->error, LS_ARGS_ERR_ABORTED, -1, k, NULL, 0);
+    }
+    return 1;
+}
+
+/* The body of `ls_args_read_positionals`, which handles the error */
+static int _lsa_read_positionals(ls_args* a, int fd, char* buf, size_t size,
+    int flags, const ls_args_events* events) {
+    const ls_args_arg* rest = _lsa_pos_rest(a);
+    char sep = (flags & LS_ARGS_STREAM_NUL) ? '\0' : '\n';
+    /* bytes in `buf`, and how many of them are known to hold no separator */
+    size_t have = 0;
+    size_t scanned = 0;
+    for (;;) {
+        size_t start = 0;
+        char* end;
+        ssize_t n;
+        if (have == size) {
+            /* one positional fills the whole buffer */
+            errno = ENOBUFS;
+            return _lsa_fail(&a->error, LS_ARGS_ERR_STREAM, -1, -1, NULL, 0);
+        }
+        n = read(fd, buf + have, size - have);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return _lsa_fail(&a->error, LS_ARGS_ERR_STREAM, -1, -1, NULL, 0);
+        }
+        if (n == 0) {
+            /* the last one may be unterminated, and there's room for that */
+            buf[have] = '\0';
+            return have == 0 || _lsa_stream_emit(a, events, rest, buf);
+        }
+        have += (size_t)n;
+        while ((end = memchr(buf + scanned, sep, have - scanned)) != NULL) {
+            *end = '\0';
+            if (end != buf + start
+                && !_lsa_stream_emit(a, events, rest, buf + start)) {
+                return 0;
+            }
+            start = (size_t)(end - buf) + 1;
+            scanned = start;
+        }
+        /* keep the start of the next one */
+        memmove(buf, buf + start, have - start);
+        have -= start;
+        scanned = have;
+    }
+}
+
+int ls_args_read_positionals(ls_args* a, int fd, char* buf, size_t size,
+    int flags, const ls_args_events* events) {
+    int ok;
+    assert(a != NULL);
+    assert(buf != NULL && size > 0);
+    assert(events != NULL);
+    ok = _lsa_read_positionals(a, fd, buf, size, flags, events);
+    if (ok) {
+        _lsa_set_error_code(a, LS_ARGS_OK);
+    } else {
+        a->last_error = (char*)_lsa_error_summary(a->error.code);
+        a->_error_formatted = 0;
+        _lsa_report_error(events, &a->error);
+    }
+    return ok;
+}
+#endif
+
+void ls_args_free(ls_args* a) {
     if (a) {
-        LS_FREE(a->args);
+        if (a->_borrowed) {
+            /* all of these belong to the caller */
+            a->args = NULL;
+            a->_pos_index = NULL;
+            a->_borrowed = 0;
+            a->_table = NULL;
+#ifdef LS_ARGS_NO_SHORT_TABLE
+            if (a->_shorts == a->_array_shorts) {
+                memset(a->_array_shorts, 0, sizeof(a->_array_shorts));
+                a->_shorts = NULL;
+            }
+#endif
+        }
+        _lsa_free(a, a->args, a->args_cap * sizeof(*a->args));
         a->args = NULL;
         a->args_cap = 0;
         a->args_len = 0;
 
-        LS_FREE(a->_allocated_error);
-        a->_allocated_error = NULL;
+        _lsa_free(
+            a, a->_long_index, a->_long_index_cap * sizeof(*a->_long_index));
+        a->_long_index = NULL;
+        a->_long_index_cap = 0;
+        a->_long_count = 0;
+#ifdef LS_ARGS_NO_SHORT_TABLE
+        _lsa_free(a, a->_shorts, a->_shorts_cap);
+        a->_shorts = NULL;
+        a->_shorts_cap = 0;
+#else
+        memset(a->_short_index, 0, sizeof(a->_short_index));
+#endif
+        if (a->_compiled == NULL) {
+            _lsa_free(a, a->_pos_index, a->_pos_cap * sizeof(*a->_pos_index));
+        }
+        a->_pos_index = NULL;
+        if (a->_compiled != NULL) {
+            _lsa_free(a, a->_compiled, a->_compiled->size);
+        }
+        a->_compiled = NULL;
+        a->_pos_cap = 0;
+        a->_next_pos = 0;
+        _lsa_free(a, a->_found, a->_found_words * sizeof(*a->_found));
+        a->_found = NULL;
+        a->_found_words = 0;
+        a->_required_count = 0;
+        a->_frozen = 0;
+
         a->last_error = "";
-        LS_FREE(a->_allocated_help);
+        _lsa_free(a, a->_allocated_help, a->_allocated_help_size);
         a->_allocated_help = NULL;
+        a->_allocated_help_size = 0;
     }
 }
 #endif
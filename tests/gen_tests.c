@@ -0,0 +1,201 @@
+/* Tests the matchers generated by tools/ls_args_gen against the dynamic path,
+ * see `make gen-test`. */
+#include <stdint.h>
+#define LS_TEST_IMPLEMENTATION
+#include "ls_test.h"
+
+void* test_realloc(void* p, size_t size) { return realloc(p, size); }
+
+#define LS_REALLOC test_realloc
+#define LS_ARGS_GEN_REGISTER
+
+#include "gen_many.h"
+#include "gen_spec.h"
+
+#define MANY 3000
+
+/* Parses `argv` once with the generated table and once with the same spec
+ * registered dynamically, each into its own copy of the values, and checks
+ * that both agree. */
+static int parse_both(char** argv, int argc, struct gen_spec_opts* table_opts,
+    struct gen_spec_opts* dyn_opts, int* ok) {
+    ls_args table;
+    ls_args dyn;
+    ls_args_ctx table_ctx;
+    ls_args_ctx dyn_ctx;
+    char* table_argv[16];
+    char* dyn_argv[16];
+    int table_ok, dyn_ok;
+    size_t i;
+
+    ASSERT(argc <= 16);
+    memcpy(table_argv, argv, argc * sizeof(*argv));
+    memcpy(dyn_argv, argv, argc * sizeof(*argv));
+    memset(table_opts, 0, sizeof(*table_opts));
+    memset(dyn_opts, 0, sizeof(*dyn_opts));
+
+    ls_args_init(&table);
+    ASSERT(ls_args_use_table(&table, &gen_spec_table));
+    ls_args_init(&dyn);
+    ASSERT(gen_spec_register(&dyn));
+    ls_args_freeze(&dyn);
+
+    ASSERT(ls_args_ctx_init(&table_ctx, &table, table_opts, &gen_spec));
+    ASSERT(ls_args_ctx_init(&dyn_ctx, &dyn, dyn_opts, &gen_spec));
+    table_ok = ls_args_ctx_parse(&table_ctx, argc, table_argv);
+    dyn_ok = ls_args_ctx_parse(&dyn_ctx, argc, dyn_argv);
+    ASSERT_EQ(table_ok, dyn_ok, "%d");
+    ASSERT_EQ(table_ctx.error.code, dyn_ctx.error.code, "%d");
+    ASSERT_STR_EQ(ls_args_ctx_error(&table_ctx), ls_args_ctx_error(&dyn_ctx));
+    ASSERT_STR_EQ(ls_args_help(&table), ls_args_help(&dyn));
+
+    ASSERT_EQ(table_opts->help, dyn_opts->help, "%d");
+    ASSERT_EQ(table_opts->verbose, dyn_opts->verbose, "%d");
+    ASSERT_EQ(table_opts->quiet, dyn_opts->quiet, "%d");
+    ASSERT(table_opts->out == dyn_opts->out);
+    ASSERT(table_opts->output_dir == dyn_opts->output_dir);
+    ASSERT(table_opts->include == dyn_opts->include);
+    ASSERT_EQ(table_opts->version, dyn_opts->version, "%d");
+    ASSERT_EQ(table_opts->verify, dyn_opts->verify, "%d");
+    ASSERT_EQ(table_opts->dry_run, dyn_opts->dry_run, "%d");
+    ASSERT_EQ(table_opts->n, dyn_opts->n, "%d");
+    ASSERT(table_opts->jobs == dyn_opts->jobs);
+    ASSERT(table_opts->ratio == dyn_opts->ratio);
+    ASSERT_EQ(table_opts->default_, dyn_opts->default_, "%d");
+    ASSERT(table_opts->short_ == dyn_opts->short_);
+    ASSERT(table_opts->mode == dyn_opts->mode);
+    ASSERT(table_opts->input == dyn_opts->input);
+    ASSERT(table_opts->extra == dyn_opts->extra);
+    ASSERT_EQ(table_opts->files.count, dyn_opts->files.count, "%zu");
+    for (i = 0; i < table_opts->files.count; ++i) {
+        ASSERT(table_opts->files.begin[i] == dyn_opts->files.begin[i]);
+    }
+    /* the views point into the copies, which go away */
+    table_opts->files.begin = NULL;
+    dyn_opts->files.begin = NULL;
+    *ok = table_ok;
+
+    ls_args_ctx_free(&table_ctx);
+    ls_args_ctx_free(&dyn_ctx);
+    ls_args_free(&table);
+    ls_args_free(&dyn);
+    return 0;
+}
+
+TEST_CASE(spec_matches_dynamic) {
+    struct gen_spec_opts t, d;
+    int ok;
+    char* valid[] = { "./prog", "-vq", "--out", "o.txt", "in", "--dry-run",
+        "-I", "inc", "--verify", "-m", "fast", "x", "a", "-n", "b" };
+    char* dashes[] = { "./prog", "-m", "small", "--output-dir", "dir", "-j",
+        "-4", "--ratio", "2.5e-1", "--version", "-V", "--", "--in", "-x",
+        "--help" };
+    char* duplicate[] = { "./prog", "--verbose", "-m", "m", "in" };
+    char* unknown_long[] = { "./prog", "--verb", "-m", "m", "in" };
+    char* same_length[] = { "./prog", "--versiox", "-m", "m", "in" };
+    char* unknown_short[] = { "./prog", "-vx", "-m", "m", "in" };
+    char* missing[] = { "./prog", "-m", "m" };
+    char* missing_value[] = { "./prog", "in", "-m" };
+    char* keywords[] = { "./prog", "--default", "--short", "s", "-m", "m",
+        "in" };
+
+    if (parse_both(valid, 15, &t, &d, &ok))
+        return 1;
+    ASSERT(ok);
+    ASSERT_EQ(t.verbose, 1, "%d");
+    ASSERT_STR_EQ(t.out, "o.txt");
+    ASSERT_STR_EQ(t.extra, "x");
+    ASSERT_EQ(t.files.count, (size_t)2, "%zu");
+
+    if (parse_both(dashes, 15, &t, &d, &ok))
+        return 1;
+    ASSERT(ok);
+    ASSERT_STR_EQ(t.output_dir, "dir");
+    ASSERT(t.jobs == -4 && t.ratio == 0.25);
+    ASSERT_EQ(t.files.count, (size_t)1, "%zu");
+
+    if (parse_both(keywords, 7, &t, &d, &ok))
+        return 1;
+    ASSERT(ok);
+    ASSERT_EQ(t.default_, 1, "%d");
+    ASSERT_STR_EQ(t.short_, "s");
+
+    if (parse_both(duplicate, 5, &t, &d, &ok))
+        return 1;
+    ASSERT(ok);
+    if (parse_both(unknown_long, 5, &t, &d, &ok))
+        return 1;
+    ASSERT(!ok);
+    if (parse_both(same_length, 5, &t, &d, &ok))
+        return 1;
+    ASSERT(!ok);
+    if (parse_both(unknown_short, 5, &t, &d, &ok))
+        return 1;
+    ASSERT(!ok);
+    if (parse_both(missing, 3, &t, &d, &ok))
+        return 1;
+    ASSERT(!ok);
+    if (parse_both(missing_value, 3, &t, &d, &ok))
+        return 1;
+    ASSERT(!ok);
+    return 0;
+}
+
+TEST_CASE(many_matches_dynamic) {
+    static struct gen_many_opts t, d;
+    ls_args table;
+    ls_args dyn;
+    ls_args_ctx table_ctx;
+    ls_args_ctx dyn_ctx;
+    char arg[32];
+    char* argv[] = { "./prog", arg };
+    const char* prefixes[] = { "opt", "xopt", "op", "opu", "opt-" };
+    const char* suffixes[] = { "", "0", "x", "-" };
+    int i, p, s;
+
+    ls_args_init(&table);
+    ASSERT(ls_args_use_table(&table, &gen_many_table));
+    ls_args_init(&dyn);
+    ASSERT(gen_many_register(&dyn));
+    ASSERT(ls_args_compile(&dyn));
+    ASSERT(ls_args_ctx_init(&table_ctx, &table, &t, &gen_many));
+    ASSERT(ls_args_ctx_init(&dyn_ctx, &dyn, &d, &gen_many));
+
+    for (i = 0; i < MANY + 10; ++i) {
+        for (p = 0; p < 5; ++p) {
+            for (s = 0; s < 4; ++s) {
+                int table_ok, dyn_ok;
+                sprintf(arg, "--%s%d%s", prefixes[p], i, suffixes[s]);
+                memset(&t, 0, sizeof(t));
+                memset(&d, 0, sizeof(d));
+                table_ok = ls_args_ctx_parse(&table_ctx, 2, argv);
+                dyn_ok = ls_args_ctx_parse(&dyn_ctx, 2, argv);
+                ASSERT_EQ(table_ok, dyn_ok, "%d");
+                /* `--opt1` + `0` is `--opt10`, which exists */
+                ASSERT_EQ(table_ok,
+                    p == 0
+                        && (s == 0 ? i < MANY
+                                   : s == 1 && i > 0 && i * 10 < MANY),
+                    "%d");
+                ASSERT(memcmp(&t, &d, sizeof(t)) == 0);
+            }
+        }
+        /* short options */
+        sprintf(arg, "-%c", (char)i);
+        if (i > 0 && i < 256) {
+            memset(&t, 0, sizeof(t));
+            memset(&d, 0, sizeof(d));
+            ASSERT_EQ(ls_args_ctx_parse(&table_ctx, 2, argv),
+                ls_args_ctx_parse(&dyn_ctx, 2, argv), "%d");
+            ASSERT(memcmp(&t, &d, sizeof(t)) == 0);
+        }
+    }
+
+    ls_args_ctx_free(&table_ctx);
+    ls_args_ctx_free(&dyn_ctx);
+    ls_args_free(&table);
+    ls_args_free(&dyn);
+    return 0;
+}
+
+TEST_MAIN
@@ -1,12 +1,18 @@
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <unistd.h>
 #define LS_TEST_IMPLEMENTATION
 #include "ls_test.h"
 
 int fail_alloc_once = 0;
 int alloc_limit = -1;
+int alloc_count = 0;
 
 void* test_realloc(void* p, size_t size) {
+    alloc_count += 1;
     if (fail_alloc_once) {
         fail_alloc_once = 0;
         return NULL;
@@ -70,7 +76,7 @@ TEST_CASE(basic_args) {
     ls_args_bool(&args, &test, "t", "test", "A test argument", 0);
     ls_args_bool(&args, &no, "n", "nope", "An argument that isn't present", 0);
     if (!ls_args_parse(&args, argc, argv)) {
-        printf("Error: %s\n", args.last_error);
+        printf("Error: %s\n", ls_args_error(&args));
         ASSERT(!"ls_args_parse failed");
     }
     ASSERT_EQ(help, 1, "%d");
@@ -98,7 +104,7 @@ TEST_CASE(basic_args_with_unused_positionals) {
     ls_args_bool(&args, &no, "n", "nope", "An argument that isn't present", 0);
     ls_args_pos_string(&args, &unused, "Not used", 0);
     if (!ls_args_parse(&args, argc, argv)) {
-        printf("Error: %s\n", args.last_error);
+        printf("Error: %s\n", ls_args_error(&args));
         ASSERT(!"ls_args_parse failed");
     }
     ASSERT_EQ(help, 1, "%d");
@@ -290,11 +296,16 @@ TEST_CASE(help_alloc_limit_sweep) {
      * For each limit, call ls_args_help multiple times to verify repeated
      * failures. */
     for (limit = 0; limit <= 8192 && !succeeded; ++limit) {
+        int count_before;
 
         /* First attempt */
         alloc_limit = limit;
+        count_before = alloc_count;
         help_str = ls_args_help(&args);
         alloc_limit = -1;
+        /* the text is measured first and then allocated exactly once,
+         * whether that allocation works or not */
+        ASSERT_EQ(alloc_count - count_before, 1, "%d");
         if (help_str == NULL || strcmp(args.last_error, "Success") != 0) {
             /* Expect allocation-related failure while we are below the needed
              * size */
@@ -415,7 +426,7 @@ TEST_CASE(basic_args_required) {
     ls_args_bool(
         &args, &test, "t", "test", "A test argument", LS_ARGS_REQUIRED);
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Required argument '--test' not found");
+    ASSERT_STR_EQ(ls_args_error(&args), "Required argument '--test' not found");
 
     char* argv2[] = { "./hello", "-h", "-t", NULL };
     int argc2 = sizeof(argv2) / sizeof(*argv2) - 1;
@@ -445,7 +456,7 @@ TEST_CASE(basic_args_positional) {
     ls_args_pos_string(&args, &output, "Output file", 0);
 
     if (!ls_args_parse(&args, argc, argv)) {
-        printf("Error: %s\n", args.last_error);
+        printf("Error: %s\n", ls_args_error(&args));
         ASSERT(!"ls_args_parse failed");
     }
     ASSERT_EQ(help, 1, "%d");
@@ -469,7 +480,7 @@ TEST_CASE(too_many_positional_after_double_dash) {
     ls_args_pos_string(&args, &second, "Second positional argument", 0);
 
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Unexpected argument 'three'");
+    ASSERT_STR_EQ(ls_args_error(&args), "Unexpected argument 'three'");
     ls_args_free(&args);
     return 0;
 }
@@ -486,7 +497,7 @@ TEST_CASE(basic_args_positional_required_error) {
     ASSERT(!ls_args_parse(&args, argc, argv));
 
     ASSERT_STR_EQ(
-        args.last_error, "Required argument 'first file' not provided");
+        ls_args_error(&args), "Required argument 'first file' not provided");
     ls_args_free(&args);
     return 0;
 }
@@ -528,7 +539,7 @@ TEST_CASE(two_positional_second_required) {
     ls_args_pos_string(&args, &second, "second", LS_ARGS_REQUIRED);
 
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Required argument 'second' not provided");
+    ASSERT_STR_EQ(ls_args_error(&args), "Required argument 'second' not provided");
 
     ls_args_free(&args);
     return 0;
@@ -561,7 +572,7 @@ TEST_CASE(basic_args_positional_only_error) {
 
     ASSERT(!ls_args_parse(&args, argc, argv));
 
-    ASSERT_STR_EQ(args.last_error, "Unexpected argument 'world'");
+    ASSERT_STR_EQ(ls_args_error(&args), "Unexpected argument 'world'");
     ls_args_free(&args);
     return 0;
 }
@@ -579,7 +590,7 @@ TEST_CASE(basic_args_only_short) {
     ls_args_bool(&args, &test, "t", NULL, "A test argument", 0);
     ls_args_bool(&args, &no, "n", NULL, "An argument that isn't present", 0);
     if (!ls_args_parse(&args, argc, argv)) {
-        printf("Error: %s\n", args.last_error);
+        printf("Error: %s\n", ls_args_error(&args));
         ASSERT(!"ls_args_parse failed");
     }
     ASSERT_EQ(help, 1, "%d");
@@ -602,7 +613,7 @@ TEST_CASE(basic_args_only_long) {
     ls_args_bool(&args, &test, NULL, "test", "A test argument", 0);
     ls_args_bool(&args, &no, NULL, "nope", "An argument that isn't present", 0);
     if (!ls_args_parse(&args, argc, argv)) {
-        printf("Error: %s\n", args.last_error);
+        printf("Error: %s\n", ls_args_error(&args));
         ASSERT(!"ls_args_parse failed");
     }
     ASSERT_EQ(help, 1, "%d");
@@ -625,7 +636,7 @@ TEST_CASE(basic_args_short_combined) {
     ls_args_bool(&args, &test, "t", "test", "A test argument", 0);
     ls_args_bool(&args, &no, "n", "nope", "An argument that isn't present", 0);
     if (!ls_args_parse(&args, argc, argv)) {
-        printf("Error: %s\n", args.last_error);
+        printf("Error: %s\n", ls_args_error(&args));
         ASSERT(!"ls_args_parse failed");
     }
     ASSERT_EQ(help, 1, "%d");
@@ -644,7 +655,7 @@ TEST_CASE(error_invalid_argument) {
     ls_args_init(&args);
     ls_args_bool(&args, &help, "h", "help", "Provides help", 0);
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Invalid argument '--test'");
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument '--test'");
     ls_args_free(&args);
     return 0;
 }
@@ -660,7 +671,7 @@ TEST_CASE(error_expected_argument) {
     ls_args_bool(&args, &help, "h", "help", "Provides help", 0);
     ls_args_string(&args, &file, "f", "file", "File to work on", 0);
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Expected argument following '--file'");
+    ASSERT_STR_EQ(ls_args_error(&args), "Expected argument following '--file'");
     ls_args_free(&args);
     return 0;
 }
@@ -674,7 +685,7 @@ TEST_CASE(error_expected_argument_last_arg) {
     ls_args_init(&args);
     ls_args_string(&args, &file, "f", "file", "File to work on", 0);
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Expected argument following '--file'");
+    ASSERT_STR_EQ(ls_args_error(&args), "Expected argument following '--file'");
     ls_args_free(&args);
     return 0;
 }
@@ -690,7 +701,7 @@ TEST_CASE(error_expected_argument_short_combined) {
     ls_args_bool(&args, &help, "h", "help", "Provides help", 0);
     ls_args_string(&args, &file, "f", "file", "File to work on", 0);
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error,
+    ASSERT_STR_EQ(ls_args_error(&args),
         "Expected argument following '-f', instead got another argument '-h'");
     ls_args_free(&args);
     return 0;
@@ -704,7 +715,7 @@ TEST_CASE(error_parse_fail) {
 
     ls_args_init(&args);
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Invalid argument '-'");
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument '-'");
     ls_args_free(&args);
     return 0;
 }
@@ -746,7 +757,7 @@ TEST_CASE(strip_dashes) {
     ls_args_bool(
         &args, &no, "-n", "----nope", "An argument that isn't present", 0);
     if (!ls_args_parse(&args, argc, argv)) {
-        printf("Error: %s\n", args.last_error);
+        printf("Error: %s\n", ls_args_error(&args));
         ASSERT(!"ls_args_parse failed");
     }
     ASSERT_EQ(help, 1, "%d");
@@ -808,7 +819,7 @@ TEST_CASE(error_parse_fail_empty) {
 
     ls_args_init(&args);
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Invalid argument ''");
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument ''");
     ls_args_free(&args);
     return 0;
 }
@@ -853,7 +864,7 @@ TEST_CASE(error_invalid_argument_short) {
     ls_args_init(&args);
     ls_args_bool(&args, &help, "h", "help", "Provides help", 0);
     ASSERT(!ls_args_parse(&args, argc, argv));
-    ASSERT_STR_EQ(args.last_error, "Invalid argument '-t'");
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument '-t'");
     ls_args_free(&args);
     return 0;
 }
@@ -879,4 +890,2018 @@ TEST_CASE(string_args) {
     return 0;
 }
 
+TEST_CASE(many_long_options) {
+    enum { N = 3000 };
+    static char names[N][16];
+    static int vals[N];
+    ls_args args;
+    int i;
+    char* argv[] = { "./program", "--opt0", "--opt1499", "--opt2999", NULL };
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    char* argv_bad[] = { "./program", "--opt3000", NULL };
+
+    ls_args_init(&args);
+    for (i = 0; i < N; ++i) {
+        sprintf(names[i], "opt%d", i);
+        vals[i] = 0;
+        ASSERT(ls_args_bool(&args, &vals[i], NULL, names[i], "Generated", 0));
+    }
+    ASSERT(ls_args_parse(&args, argc, argv));
+    for (i = 0; i < N; ++i) {
+        ASSERT_EQ(vals[i], i == 0 || i == 1499 || i == 2999, "%d");
+    }
+    ASSERT(!ls_args_parse(&args, 2, argv_bad));
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument '--opt3000'");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(duplicate_long_option_first_wins) {
+    int first = 0;
+    int second = 0;
+    ls_args args;
+    char* argv[] = { "./program", "--same", NULL };
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+    ls_args_init(&args);
+    ls_args_bool(&args, &first, "a", "same", "First", 0);
+    ls_args_bool(&args, &second, "b", "same", "Second", 0);
+    ASSERT(ls_args_parse(&args, argc, argv));
+    ASSERT_EQ(first, 1, "%d");
+    ASSERT_EQ(second, 0, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(alloc_fail_long_index) {
+    int a = 0;
+    int b = 0;
+    ls_args args;
+    char* argv[] = { "./program", "-a", NULL };
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    int ret;
+
+    ls_args_init(&args);
+    /* short-only, so only the args vector is allocated */
+    ASSERT(ls_args_bool(&args, &a, "a", NULL, "Short only", 0));
+    /* the vector has room, so the next allocation is the long index */
+    fail_alloc_once = 1;
+    ret = ls_args_bool(&args, &b, "b", "bee", "Has a long name", 0);
+    ASSERT(!ret);
+    ASSERT_STR_EQ(args.last_error, "Allocation failure");
+    ASSERT_EQ(args.args_len, 1, "%uz");
+    ASSERT(ls_args_parse(&args, argc, argv));
+    ASSERT_EQ(a, 1, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(short_cluster_many_options) {
+    static const char letters[]
+        = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    enum { N = sizeof(letters) - 1 };
+    static char names[N][2];
+    static int vals[N];
+    int dup = 0;
+    ls_args args;
+    char* argv[] = { "./program", "-zyxAZ", "-\xe9", NULL };
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    int high = 0;
+    int i;
+
+    ls_args_init(&args);
+    for (i = 0; i < N; ++i) {
+        names[i][0] = letters[i];
+        names[i][1] = '\0';
+        vals[i] = 0;
+        ASSERT(ls_args_bool(&args, &vals[i], names[i], NULL, "Generated", 0));
+    }
+    /* a later registration of the same short option is shadowed */
+    ASSERT(ls_args_bool(&args, &dup, "z", NULL, "Duplicate", 0));
+    /* bytes outside of ASCII work, too */
+    ASSERT(ls_args_bool(&args, &high, "\xe9", NULL, "High byte", 0));
+    ASSERT(ls_args_parse(&args, argc, argv));
+    for (i = 0; i < N; ++i) {
+        int expected = strchr("zyxAZ", letters[i]) != NULL;
+        ASSERT_EQ(vals[i], expected, "%d");
+    }
+    ASSERT_EQ(dup, 0, "%d");
+    ASSERT_EQ(high, 1, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(many_positionals) {
+    enum { N = 1000 };
+    static const char* vals[N];
+    static char* argv[N + 3];
+    static char tokens[N][8];
+    int flag = 0;
+    ls_args args;
+    int i;
+
+    ls_args_init(&args);
+    argv[0] = "./program";
+    for (i = 0; i < N; ++i) {
+        vals[i] = NULL;
+        sprintf(tokens[i], "p%d", i);
+        ASSERT(ls_args_pos_string(&args, &vals[i], "Generated", 0));
+        if (i == N / 2) {
+            ASSERT(ls_args_bool(&args, &flag, "f", "flag", "A flag", 0));
+        }
+    }
+    /* fill all but the last slot, with a flag somewhere in the middle */
+    for (i = 0; i < N - 1; ++i) {
+        argv[i + 1] = tokens[i];
+    }
+    argv[N] = "--flag";
+    ASSERT(ls_args_parse(&args, N + 1, argv));
+    for (i = 0; i < N - 1; ++i) {
+        ASSERT_STR_EQ(vals[i], (const char*)tokens[i]);
+    }
+    ASSERT(vals[N - 1] == NULL);
+    ASSERT_EQ(flag, 1, "%d");
+
+    /* one past the last slot is rejected */
+    argv[N] = tokens[N - 1];
+    argv[N + 1] = "extra";
+    ASSERT(!ls_args_parse(&args, N + 2, argv));
+    ASSERT_STR_EQ(ls_args_error(&args), "Unexpected argument 'extra'");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(rest_interleaved) {
+    const char* first = NULL;
+    const char* out = NULL;
+    int verbose = 0;
+    ls_args_rest files = { NULL, 0 };
+    ls_args args;
+    char* argv[] = { "./program", "-v", "a", "b", "-o", "out", "c", "--",
+        "-d", NULL };
+    char* orig[sizeof(argv) / sizeof(*argv)];
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    int i, k;
+
+    memcpy(orig, argv, sizeof(argv));
+    ls_args_init(&args);
+    ls_args_bool(&args, &verbose, "v", "verbose", "Verbose", 0);
+    ls_args_string(&args, &out, "o", "out", "Output", 0);
+    ls_args_pos_string(&args, &first, "first", LS_ARGS_REQUIRED);
+    ls_args_pos_rest(&args, &files, "files", 0);
+    ASSERT(ls_args_parse(&args, argc, argv));
+    ASSERT_EQ(verbose, 1, "%d");
+    ASSERT_STR_EQ(out, "out");
+    ASSERT_STR_EQ(first, "a");
+    ASSERT_EQ(files.count, 3, "%zu");
+    /* a view into argv, not a copy */
+    ASSERT(files.begin == &argv[3]);
+    ASSERT_STR_EQ(files.begin[0], "b");
+    ASSERT_STR_EQ(files.begin[1], "c");
+    ASSERT_STR_EQ(files.begin[2], "-d");
+    /* argv is still a permutation of itself */
+    for (i = 0; i < argc; ++i) {
+        int seen = 0;
+        for (k = 0; k < argc; ++k) {
+            seen += argv[k] == orig[i];
+        }
+        ASSERT_EQ(seen, 1, "%d");
+    }
+    ASSERT(strstr(ls_args_help(&args), "[files...]") != NULL);
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(rest_many_and_required) {
+    enum { N = 50000 };
+    static char* argv[N + 1];
+    ls_args_rest files = { NULL, 0 };
+    ls_args args;
+    int i;
+
+    ls_args_init(&args);
+    ls_args_pos_rest(&args, &files, "files", LS_ARGS_REQUIRED);
+    argv[0] = "./program";
+    ASSERT(!ls_args_parse(&args, 1, argv));
+    ASSERT_STR_EQ(ls_args_error(&args), "Required argument 'files' not provided");
+    for (i = 1; i <= N; ++i) {
+        argv[i] = "path";
+    }
+    ASSERT(ls_args_parse(&args, N + 1, argv));
+    ASSERT(files.begin == &argv[1]);
+    ASSERT_EQ(files.count, (size_t)N, "%zu");
+    /* reparsing starts a fresh view */
+    ASSERT(ls_args_parse(&args, 3, argv));
+    ASSERT_EQ(files.count, 2, "%zu");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(required_repeated_does_not_count_twice) {
+    int a_val = 0;
+    int b_val = 0;
+    ls_args args;
+    char* argv[] = { "./program", "-a", "--aaa", "-aa", NULL };
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    char* argv2[] = { "./program", "-ab", NULL };
+    int argc2 = sizeof(argv2) / sizeof(*argv2) - 1;
+
+    ls_args_init(&args);
+    ls_args_bool(&args, &a_val, "a", "aaa", "First", LS_ARGS_REQUIRED);
+    ls_args_bool(&args, &b_val, "b", "bbb", "Second", LS_ARGS_REQUIRED);
+    ASSERT(!ls_args_parse(&args, argc, argv));
+    ASSERT_STR_EQ(ls_args_error(&args), "Required argument '--bbb' not found");
+    ASSERT(ls_args_parse(&args, argc2, argv2));
+    ASSERT_STR_EQ(args.last_error, "Success");
+    /* found state is reset between parses */
+    ASSERT(!ls_args_parse(&args, 1, argv));
+    ASSERT_STR_EQ(ls_args_error(&args), "Required argument '--aaa' not found");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(help_many_options_single_allocation) {
+    enum { N = 3000 };
+    static char names[N][16];
+    static int vals[N];
+    ls_args args;
+    char* help_str;
+    int count_before;
+    int i;
+
+    ls_args_init(&args);
+    for (i = 0; i < N; ++i) {
+        sprintf(names[i], "opt%d", i);
+        ASSERT(ls_args_bool(&args, &vals[i], "x", names[i], "Generated", 0));
+    }
+    count_before = alloc_count;
+    help_str = ls_args_help(&args);
+    ASSERT_EQ(alloc_count - count_before, 1, "%d");
+    ASSERT_STR_EQ(args.last_error, "Success");
+    ASSERT(strstr(help_str, "--opt0 \t\t\tGenerated") != NULL);
+    ASSERT(strstr(help_str, "--opt2999 \t\t\tGenerated") != NULL);
+    ls_args_free(&args);
+    return 0;
+}
+
+typedef struct collect_sink {
+    char data[4096];
+    size_t length;
+    size_t batches;
+} collect_sink;
+
+static int collect(void* user, const ls_args_iovec* iov, size_t count) {
+    collect_sink* c = (collect_sink*)user;
+    size_t i;
+    c->batches += 1;
+    for (i = 0; i < count; ++i) {
+        if (c->length + iov[i].len >= sizeof(c->data)) {
+            return 0;
+        }
+        memcpy(c->data + c->length, iov[i].base, iov[i].len);
+        c->length += iov[i].len;
+    }
+    c->data[c->length] = '\0';
+    return 1;
+}
+
+TEST_CASE(help_stream_matches_help) {
+    int help = 0;
+    int vals[40];
+    const char* outfile = NULL;
+    const char* infile = NULL;
+    ls_args args;
+    collect_sink sink;
+    int count_before;
+    int i;
+
+    ls_args_init(&args);
+    args.help_description = "Streams help.";
+    ls_args_bool(&args, &help, "h", "help", "Provides help", 0);
+    ls_args_string(&args, &outfile, "o", "out", "Output", LS_ARGS_REQUIRED);
+    /* enough pieces to need more than one batch */
+    for (i = 0; i < 40; ++i) {
+        ls_args_bool(&args, &vals[i], "x", "many", "Repeated", 0);
+    }
+    ls_args_pos_string(&args, &infile, "Input file", 0);
+
+    sink.length = 0;
+    sink.batches = 0;
+    count_before = alloc_count;
+    ASSERT(ls_args_help_stream(&args, collect, &sink));
+    ASSERT_EQ(alloc_count, count_before, "%d");
+    ASSERT_GT(sink.batches, 1, "%zu");
+    ASSERT_STR_EQ((const char*)sink.data, ls_args_help(&args));
+
+    /* a failing sink stops rendering */
+    sink.length = sizeof(sink.data);
+    ASSERT(!ls_args_help_stream(&args, collect, &sink));
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(help_fd) {
+    int help = 0;
+    ls_args args;
+    int fds[2];
+    char buf[512];
+    ssize_t n;
+
+    ls_args_init(&args);
+    ls_args_bool(&args, &help, "h", "help", "Provides help", 0);
+    ASSERT(pipe(fds) == 0);
+    ASSERT(ls_args_help_fd(&args, fds[1]));
+    close(fds[1]);
+    n = read(fds[0], buf, sizeof(buf) - 1);
+    close(fds[0]);
+    ASSERT(n > 0);
+    buf[n] = '\0';
+    ASSERT_STR_EQ((const char*)buf, ls_args_help(&args));
+    /* writing to a closed descriptor fails */
+    ASSERT(!ls_args_help_fd(&args, fds[1]));
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(structured_errors) {
+    int help = 0;
+    const char* file = NULL;
+    ls_args args;
+    char* argv[] = { "./program", "-h", "--nope", NULL };
+    char* argv2[] = { "./program", "-hf", NULL };
+    char* argv3[] = { "./program", "-h", NULL };
+    char* argv4[] = { "./program", "stray", NULL };
+    int count_before;
+
+    ls_args_init(&args);
+    ls_args_bool(&args, &help, "h", "help", "Provides help", 0);
+    ls_args_string(&args, &file, "f", NULL, "File", LS_ARGS_REQUIRED);
+
+    count_before = alloc_count;
+    ASSERT(!ls_args_parse(&args, 3, argv));
+    ASSERT(!ls_args_parse(&args, 2, argv2));
+    ASSERT(!ls_args_parse(&args, 2, argv3));
+    ASSERT(!ls_args_parse(&args, 2, argv4));
+    /* the error path never allocates */
+    ASSERT_EQ(alloc_count, count_before, "%d");
+
+    ASSERT(!ls_args_parse(&args, 3, argv));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_UNKNOWN_LONG, "%d");
+    ASSERT_EQ(args.error.argv_index, 2, "%d");
+    ASSERT_EQ(args.error.arg_index, -1L, "%ld");
+    ASSERT_STR_EQ(args.last_error, "Invalid argument");
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument '--nope'");
+
+    ASSERT(!ls_args_parse(&args, 2, argv2));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_MISSING_VALUE, "%d");
+    ASSERT_EQ(args.error.argv_index, 1, "%d");
+    ASSERT_EQ(args.error.arg_index, 1L, "%ld");
+    /* options without a long name are reported by their short name */
+    ASSERT_STR_EQ(ls_args_error(&args), "Expected argument following '-f'");
+
+    ASSERT(!ls_args_parse(&args, 2, argv3));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_REQUIRED, "%d");
+    ASSERT_EQ(args.error.argv_index, -1, "%d");
+    ASSERT_EQ(args.error.arg_index, 1L, "%ld");
+    ASSERT_STR_EQ(ls_args_error(&args), "Required argument '-f' not found");
+
+    ASSERT(!ls_args_parse(&args, 2, argv4));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_UNEXPECTED, "%d");
+    ASSERT_EQ(args.error.argv_index, 1, "%d");
+    ASSERT_STR_EQ(ls_args_error(&args), "Unexpected argument 'stray'");
+
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(error_message_truncated) {
+    ls_args args;
+    char token[1024];
+    char* argv[] = { "./program", token, NULL };
+    const char* msg;
+
+    memset(token, 'x', sizeof(token) - 1);
+    token[sizeof(token) - 1] = '\0';
+    ls_args_init(&args);
+    ASSERT(!ls_args_parse(&args, 2, argv));
+    msg = ls_args_error(&args);
+    ASSERT_LT(strlen(msg), (size_t)LS_ARGS_ERROR_MAX, "%zu");
+    ASSERT(strncmp(msg, "Unexpected argument 'xxx", 24) == 0);
+    ls_args_free(&args);
+    return 0;
+}
+
+typedef struct ctx_opts {
+    int verbose;
+    const char* out;
+    const char* input;
+    ls_args_rest rest;
+} ctx_opts;
+
+typedef struct ctx_job {
+    const ls_args* spec;
+    const ctx_opts* layout;
+    int id;
+    int failures;
+} ctx_job;
+
+static void* ctx_worker(void* user) {
+    ctx_job* job = (ctx_job*)user;
+    ls_args_ctx ctx;
+    ctx_opts mine;
+    char out[32];
+    int round;
+    sprintf(out, "out%d", job->id);
+    if (!ls_args_ctx_init(&ctx, job->spec, &mine, job->layout)) {
+        job->failures += 1;
+        return NULL;
+    }
+    for (round = 0; round < 2000; ++round) {
+        char* argv[] = { "./program", "in", "-o", out, "x", "y", NULL };
+        char* bad[] = { "./program", "-q", NULL };
+        int verbose_round = round % 2;
+        memset(&mine, 0, sizeof(mine));
+        argv[5] = verbose_round ? "-v" : "y";
+        if (!ls_args_ctx_parse(&ctx, 6, argv) || mine.verbose != verbose_round
+            || strcmp(mine.out, out) != 0 || strcmp(mine.input, "in") != 0
+            || mine.rest.count != (size_t)(verbose_round ? 1 : 2)) {
+            job->failures += 1;
+        }
+        if (ls_args_ctx_parse(&ctx, 2, bad)
+            || strcmp(ls_args_ctx_error(&ctx), "Invalid argument '-q'") != 0) {
+            job->failures += 1;
+        }
+    }
+    ls_args_ctx_free(&ctx);
+    return NULL;
+}
+
+TEST_CASE(ctx_shared_spec_threads) {
+    enum { THREADS = 4 };
+    static ctx_opts layout;
+    ls_args spec;
+    pthread_t threads[THREADS];
+    ctx_job jobs[THREADS];
+    int i;
+
+    ls_args_init(&spec);
+    ls_args_bool(&spec, &layout.verbose, "v", "verbose", "Verbose", 0);
+    ls_args_string(&spec, &layout.out, "o", "out", "Output", LS_ARGS_REQUIRED);
+    ls_args_pos_string(&spec, &layout.input, "input", LS_ARGS_REQUIRED);
+    ls_args_pos_rest(&spec, &layout.rest, "rest", 0);
+    ls_args_freeze(&spec);
+
+    for (i = 0; i < THREADS; ++i) {
+        jobs[i].spec = &spec;
+        jobs[i].layout = &layout;
+        jobs[i].id = i;
+        jobs[i].failures = 0;
+        ASSERT(pthread_create(&threads[i], NULL, ctx_worker, &jobs[i]) == 0);
+    }
+    for (i = 0; i < THREADS; ++i) {
+        ASSERT(pthread_join(threads[i], NULL) == 0);
+        ASSERT_EQ(jobs[i].failures, 0, "%d");
+    }
+    /* the registered storage itself was never written */
+    ASSERT(layout.out == NULL);
+    ASSERT_EQ(layout.verbose, 0, "%d");
+    ls_args_free(&spec);
+    return 0;
+}
+
+TEST_CASE(ctx_without_layout) {
+    int verbose = 0;
+    ls_args spec;
+    ls_args_ctx ctx;
+    char* argv[] = { "./program", "--verbose", NULL };
+
+    ls_args_init(&spec);
+    ls_args_bool(&spec, &verbose, "v", "verbose", "Verbose", LS_ARGS_REQUIRED);
+    ls_args_freeze(&spec);
+    ASSERT(ls_args_ctx_init(&ctx, &spec, NULL, NULL));
+    ASSERT(!ls_args_ctx_parse(&ctx, 1, argv));
+    ASSERT_STR_EQ(
+        ls_args_ctx_error(&ctx), "Required argument '--verbose' not found");
+    ASSERT(ls_args_ctx_parse(&ctx, 2, argv));
+    ASSERT_STR_EQ(ctx.last_error, "Success");
+    ASSERT_STR_EQ(ctx.program_name, "./program");
+    ASSERT_EQ(verbose, 1, "%d");
+    ls_args_ctx_free(&ctx);
+
+    fail_alloc_once = 1;
+    ASSERT(!ls_args_ctx_init(&ctx, &spec, NULL, NULL));
+    ASSERT_EQ(ctx.error.code, LS_ARGS_ERR_ALLOC, "%d");
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&spec);
+    return 0;
+}
+
+TEST_CASE(compile_many_options) {
+    enum { N = 3000 };
+    static char names[N][16];
+    static int vals[N];
+    const char* input = NULL;
+    ls_args_rest rest = { NULL, 0 };
+    ls_args args;
+    char* argv[] = { "./program", "--opt7", "in", "-a", "--opt2999", "r1",
+        "r2", NULL };
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    char miss[32];
+    char* argv_miss[] = { "./program", miss, NULL };
+    int i;
+
+    ls_args_init(&args);
+    for (i = 0; i < N; ++i) {
+        sprintf(names[i], "opt%d", i);
+        vals[i] = 0;
+        ASSERT(ls_args_bool(&args, &vals[i], i == 0 ? "a" : NULL, names[i],
+            "Generated", 0));
+    }
+    ls_args_pos_string(&args, &input, "input", LS_ARGS_REQUIRED);
+    ls_args_pos_rest(&args, &rest, "rest", 0);
+    ASSERT(ls_args_compile(&args));
+    ASSERT(args._compiled != NULL);
+
+    ASSERT(ls_args_parse(&args, argc, argv));
+    for (i = 0; i < N; ++i) {
+        ASSERT_EQ(vals[i], i == 0 || i == 7 || i == 2999, "%d");
+    }
+    ASSERT_STR_EQ(input, "in");
+    ASSERT_EQ(rest.count, 2, "%zu");
+    /* every name is found, and nothing else */
+    for (i = 0; i < N; ++i) {
+        sprintf(miss, "--%s", names[i]);
+        ASSERT(!ls_args_parse(&args, 2, argv_miss));
+        ASSERT_EQ(args.error.code, LS_ARGS_ERR_REQUIRED, "%d");
+        sprintf(miss, "--x%s", names[i]);
+        ASSERT(!ls_args_parse(&args, 2, argv_miss));
+        ASSERT_EQ(args.error.code, LS_ARGS_ERR_UNKNOWN_LONG, "%d");
+    }
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(compile_small_and_alloc_fail) {
+    int verbose = 0;
+    const char* out = NULL;
+    ls_args args;
+    ls_args_ctx ctx;
+    char* argv[] = { "./program", "--out", "o.txt", "--verbose", NULL };
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+    ls_args_init(&args);
+    ls_args_bool(&args, &verbose, "v", "verbose", "Verbose", 0);
+    ls_args_string(&args, &out, "o", "out", "Output", 0);
+
+    /* a failure leaves everything usable */
+    fail_alloc_once = 1;
+    ASSERT(!ls_args_compile(&args));
+    ASSERT_STR_EQ(args.last_error, "Allocation failure");
+    ASSERT(args._compiled == NULL);
+    ASSERT(ls_args_parse(&args, argc, argv));
+
+    ASSERT(ls_args_compile(&args));
+    /* compiling twice is harmless */
+    ASSERT(ls_args_compile(&args));
+    verbose = 0;
+    ASSERT(ls_args_ctx_init(&ctx, &args, NULL, NULL));
+    ASSERT(ls_args_ctx_parse(&ctx, argc, argv));
+    ASSERT_EQ(verbose, 1, "%d");
+    ASSERT_STR_EQ(out, "o.txt");
+    ls_args_ctx_free(&ctx);
+
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(compile_no_long_options) {
+    int verbose = 0;
+    ls_args args;
+    char* argv[] = { "./program", "-v", NULL };
+    char* argv_bad[] = { "./program", "--v", NULL };
+
+    ls_args_init(&args);
+    ls_args_bool(&args, &verbose, "v", NULL, "Verbose", 0);
+    ASSERT(ls_args_compile(&args));
+    ASSERT(ls_args_parse(&args, 2, argv));
+    ASSERT_EQ(verbose, 1, "%d");
+    ASSERT(!ls_args_parse(&args, 2, argv_bad));
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument '--v'");
+    ls_args_free(&args);
+    return 0;
+}
+
+static struct table_opts {
+    int verbose;
+    const char* out;
+    const char* input;
+} table_opts;
+
+static const ls_args_arg table_args[] = {
+    LS_ARGS_BOOL(&table_opts.verbose, "v", "verbose", "Verbose", 0),
+    LS_ARGS_STRING(&table_opts.out, "o", "out", "Output", 0),
+    LS_ARGS_POS_STRING(&table_opts.input, "input", LS_ARGS_REQUIRED),
+};
+static const size_t table_pos_index[] = { 2 };
+
+static size_t table_match_long(const char* s, size_t len) {
+    if (len == 7 && memcmp(s, "verbose", 7) == 0)
+        return 1;
+    if (len == 3 && memcmp(s, "out", 3) == 0)
+        return 2;
+    return 0;
+}
+
+static size_t table_match_short(unsigned char c) {
+    return c == 'v' ? 1 : c == 'o' ? 2 : 0;
+}
+
+static const ls_args_table table = { table_args, 3, table_pos_index, 1, 1,
+    table_match_long, table_match_short };
+
+TEST_CASE(use_table) {
+    ls_args args;
+    char* argv[] = { "./program", "-v", "in", "--out", "o.txt", NULL };
+    char* argv_bad[] = { "./program", "--verbos", "in", NULL };
+    char* argv_missing[] = { "./program", "-vo", "o.txt", NULL };
+
+    alloc_count = 0;
+    ls_args_init(&args);
+    ASSERT(ls_args_use_table(&args, &table));
+    ASSERT(ls_args_compile(&args));
+    ASSERT(ls_args_parse(&args, 5, argv));
+    ASSERT_EQ(alloc_count, 0, "%d");
+    ASSERT_EQ(table_opts.verbose, 1, "%d");
+    ASSERT_STR_EQ(table_opts.out, "o.txt");
+    ASSERT_STR_EQ(table_opts.input, "in");
+
+    ASSERT(!ls_args_parse(&args, 3, argv_bad));
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument '--verbos'");
+    ASSERT(!ls_args_parse(&args, 3, argv_missing));
+    ASSERT_STR_EQ(
+        ls_args_error(&args), "Required argument 'input' not provided");
+    ASSERT(strstr(ls_args_help(&args), "--verbose") != NULL);
+    /* only the help text is freed */
+    ls_args_free(&args);
+    ASSERT(args.args == NULL);
+    return 0;
+}
+
+/* Parses with a second `ls_args` over the same table, in the middle of a
+ * parse with the first */
+static int parse_table_again(
+    void* user, const ls_args_arg* arg, long arg_index, int argv_index) {
+    ls_args* other = user;
+    char* argv[] = { "./program", "-v", "in", NULL };
+    (void)arg;
+    (void)arg_index;
+    (void)argv_index;
+    return ls_args_parse(other, 3, argv);
+}
+
+TEST_CASE(use_table_shared) {
+    ls_args args, other;
+    ls_args_events events;
+    char* argv[] = { "./program", "-v", "in", NULL };
+    char* argv_missing[] = { "./program", "-v", NULL };
+
+    ls_args_init(&args);
+    ls_args_init(&other);
+    ASSERT(ls_args_use_table(&args, &table));
+    ASSERT(ls_args_use_table(&other, &table));
+    memset(&events, 0, sizeof(events));
+    events.user = &other;
+    events.option = parse_table_again;
+    ASSERT(ls_args_parse_events(&args, 3, argv, &events));
+    /* with one found bitset in the table, the other parse would mark `input`
+     * as found for this one too */
+    ASSERT(!ls_args_parse_events(&args, 2, argv_missing, &events));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_REQUIRED, "%d");
+    ls_args_free(&args);
+    ls_args_free(&other);
+    return 0;
+}
+
+static ls_args_arg big_table_args[LS_ARGS_ARRAY_MAX + 1];
+
+static size_t big_table_match_long(const char* s, size_t len) {
+    (void)s;
+    (void)len;
+    return 0;
+}
+
+static size_t big_table_match_short(unsigned char c) {
+    return c == 'z' ? LS_ARGS_ARRAY_MAX + 1 : 0;
+}
+
+TEST_CASE(use_table_big) {
+    static int flags[LS_ARGS_ARRAY_MAX + 1];
+    static const ls_args_table big = { big_table_args, LS_ARGS_ARRAY_MAX + 1,
+        NULL, 0, 1, big_table_match_long, big_table_match_short };
+    ls_args args;
+    char* argv[] = { "./program", "-z", NULL };
+    size_t i;
+
+    for (i = 0; i <= LS_ARGS_ARRAY_MAX; ++i) {
+        ls_args_arg arg = LS_ARGS_BOOL(NULL, NULL, "flag", "Flag", 0);
+        arg.val_ptr = &flags[i];
+        big_table_args[i] = arg;
+    }
+    /* past the inline bits, so they're allocated */
+    big_table_args[LS_ARGS_ARRAY_MAX].short_opt = "z";
+    big_table_args[LS_ARGS_ARRAY_MAX].mode = LS_ARGS_REQUIRED;
+    ls_args_init(&args);
+    fail_alloc_once = 1;
+    ASSERT(!ls_args_use_table(&args, &big));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_ALLOC, "%d");
+    ls_args_free(&args);
+
+    alloc_count = 0;
+    ls_args_init(&args);
+    ASSERT(ls_args_use_table(&args, &big));
+    ASSERT_EQ(alloc_count, 1, "%d");
+    ASSERT(ls_args_parse(&args, 2, argv));
+    ASSERT_EQ(flags[LS_ARGS_ARRAY_MAX], 1, "%d");
+    ASSERT(!ls_args_parse(&args, 1, argv));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_REQUIRED, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+static struct array_opts {
+    int verbose;
+    int force;
+    const char* out;
+    const char* input;
+    ls_args_rest rest;
+} array_opts;
+
+static const ls_args_arg array_spec[] = {
+    LS_ARGS_BOOL(&array_opts.verbose, "v", "verbose", "Verbose", 0),
+    LS_ARGS_POS_STRING(&array_opts.input, "input", LS_ARGS_REQUIRED),
+    LS_ARGS_STRING(&array_opts.out, "o", "out", "Output", 0),
+    LS_ARGS_BOOL(&array_opts.force, "f", NULL, "Force", 0),
+    /* duplicates, the first registration wins */
+    LS_ARGS_BOOL(&array_opts.force, "v", "verbose", "Not verbose", 0),
+    LS_ARGS_POS_REST(&array_opts.rest, "files", 0),
+};
+
+TEST_CASE(use_array_no_allocation) {
+    ls_args args;
+    char* argv[] = { "./program", "in", "a", "-vf", "--out", "o.txt", "b",
+        NULL };
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    char* argv_missing[] = { "./program", "--verbose", NULL };
+    char* argv_bad[] = { "./program", "in", "-x", NULL };
+
+    alloc_count = 0;
+    memset(&array_opts, 0, sizeof(array_opts));
+    ls_args_init(&args);
+    ls_args_use_array(
+        &args, array_spec, sizeof(array_spec) / sizeof(*array_spec));
+    ASSERT(ls_args_parse(&args, argc, argv));
+    ASSERT_EQ(array_opts.verbose, 1, "%d");
+    ASSERT_EQ(array_opts.force, 1, "%d");
+    ASSERT_STR_EQ(array_opts.out, "o.txt");
+    ASSERT_STR_EQ(array_opts.input, "in");
+    ASSERT_EQ(array_opts.rest.count, 2, "%zu");
+    ASSERT_STR_EQ(array_opts.rest.begin[0], "a");
+    ASSERT_STR_EQ(array_opts.rest.begin[1], "b");
+
+    array_opts.force = 0;
+    ASSERT(!ls_args_parse(&args, 2, argv_missing));
+    ASSERT_EQ(array_opts.force, 0, "%d");
+    ASSERT_STR_EQ(
+        ls_args_error(&args), "Required argument 'input' not provided");
+    ASSERT(!ls_args_parse(&args, 3, argv_bad));
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid argument '-x'");
+    ls_args_free(&args);
+    ASSERT_EQ(alloc_count, 0, "%d");
+    return 0;
+}
+
+TEST_CASE(use_array_with_ctx) {
+    ls_args spec;
+    ls_args_ctx ctx;
+    struct array_opts mine;
+    char* argv[] = { "./program", "--out", "x", "in", NULL };
+
+    memset(&array_opts, 0, sizeof(array_opts));
+    memset(&mine, 0, sizeof(mine));
+    ls_args_init(&spec);
+    ls_args_use_array(
+        &spec, array_spec, sizeof(array_spec) / sizeof(*array_spec));
+    ASSERT(ls_args_ctx_init(&ctx, &spec, &mine, &array_opts));
+    ASSERT(ls_args_ctx_parse(&ctx, 4, argv));
+    ASSERT_STR_EQ(mine.out, "x");
+    ASSERT_STR_EQ(mine.input, "in");
+    ASSERT(array_opts.out == NULL);
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&spec);
+    return 0;
+}
+
+/* Short options past the 16 and 32 byte blocks the SIMD search looks at with
+ * LS_ARGS_NO_SHORT_TABLE */
+TEST_CASE(short_past_block) {
+    static const char* shorts[] = { "a", "b", "c", "d", "a" };
+    static const size_t at[] = { 16, 32, 39, 31, 35 };
+    static ls_args_arg many[40];
+    int flags[40];
+    ls_args args;
+    char* argv[] = { "./program", "-abcd", NULL };
+    char* argv_unknown[] = { "./program", "-e", NULL };
+    size_t i;
+    int pass;
+
+    for (pass = 0; pass < 2; ++pass) {
+        memset(flags, 0, sizeof(flags));
+        ls_args_init(&args);
+        for (i = 0; i < 40; ++i) {
+            ls_args_arg arg = LS_ARGS_BOOL(NULL, NULL, "flag", "Flag", 0);
+            arg.val_ptr = &flags[i];
+            many[i] = arg;
+        }
+        for (i = 0; i < sizeof(at) / sizeof(*at); ++i) {
+            many[at[i]].short_opt = shorts[i];
+        }
+        if (pass == 0) {
+            ASSERT(ls_args_use_array(&args, many, 40));
+        } else {
+            for (i = 0; i < 40; ++i) {
+                ASSERT(ls_args_bool(&args, &flags[i], many[i].short_opt,
+                    "flag", "Flag", 0));
+            }
+        }
+        ASSERT(ls_args_parse(&args, 2, argv));
+        for (i = 0; i < 40; ++i) {
+            /* the later `-a` loses to the first */
+            int expected = i == 16 || i == 31 || i == 32 || i == 39;
+            ASSERT_EQ(flags[i], expected, "%d");
+        }
+        ASSERT(!ls_args_parse(&args, 2, argv_unknown));
+        ASSERT_EQ(args.error.code, LS_ARGS_ERR_UNKNOWN_SHORT, "%d");
+        ls_args_free(&args);
+    }
+    return 0;
+}
+
+TEST_CASE(use_array_too_many) {
+    static ls_args_arg big[LS_ARGS_ARRAY_MAX + 1];
+    static int flags[LS_ARGS_ARRAY_MAX + 1];
+    ls_args args;
+    char* argv[] = { "./program", "-z", NULL };
+    size_t i;
+
+    for (i = 0; i <= LS_ARGS_ARRAY_MAX; ++i) {
+        ls_args_arg arg = LS_ARGS_BOOL(NULL, NULL, "flag", "Flag", 0);
+        arg.val_ptr = &flags[i];
+        big[i] = arg;
+    }
+    /* the last one is required, so every found bit is checked */
+    big[LS_ARGS_ARRAY_MAX - 1].short_opt = "z";
+    big[LS_ARGS_ARRAY_MAX - 1].mode = LS_ARGS_REQUIRED;
+    ls_args_init(&args);
+    ASSERT(!ls_args_use_array(&args, big, LS_ARGS_ARRAY_MAX + 1));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_TOO_MANY, "%d");
+    ASSERT_EQ(args.args_len, (size_t)0, "%zu");
+    ls_args_free(&args);
+
+    ls_args_init(&args);
+    ASSERT(ls_args_use_array(&args, big, LS_ARGS_ARRAY_MAX));
+    ASSERT(ls_args_parse(&args, 2, argv));
+    ASSERT_EQ(flags[LS_ARGS_ARRAY_MAX - 1], 1, "%d");
+    ASSERT(!ls_args_parse(&args, 1, argv));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_REQUIRED, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(arena_allocator) {
+    static char buf[1 << 16];
+    enum { N = 100 };
+    static char names[N][16];
+    static int vals[N];
+    const char* input = NULL;
+    ls_args_arena arena;
+    ls_args_allocator allocator;
+    ls_args args;
+    ls_args_ctx ctx;
+    char* argv[] = { "./program", "--opt42", "in", NULL };
+    int i;
+
+    ls_args_arena_init(&arena, buf, sizeof(buf));
+    allocator = ls_args_arena_allocator(&arena);
+    alloc_count = 0;
+    ls_args_init(&args);
+    ls_args_set_allocator(&args, &allocator);
+    for (i = 0; i < N; ++i) {
+        sprintf(names[i], "opt%d", i);
+        vals[i] = 0;
+        ASSERT(ls_args_bool(&args, &vals[i], NULL, names[i], "Generated", 0));
+    }
+    ASSERT(ls_args_pos_string(&args, &input, "input", LS_ARGS_REQUIRED));
+    ASSERT(ls_args_compile(&args));
+    ASSERT(ls_args_parse(&args, 3, argv));
+    ASSERT_EQ(vals[42], 1, "%d");
+    ASSERT(strstr(ls_args_help(&args), "--opt99") != NULL);
+    ASSERT(ls_args_ctx_init(&ctx, &args, NULL, NULL));
+    ASSERT(ls_args_ctx_parse(&ctx, 3, argv));
+    ls_args_ctx_free(&ctx);
+    /* all of it came from the buffer */
+    ASSERT_EQ(alloc_count, 0, "%d");
+    ASSERT(arena.used > 0);
+    ASSERT(arena.used <= sizeof(buf));
+    ls_args_free(&args);
+    ls_args_arena_reset(&arena);
+    ASSERT_EQ(arena.used, 0, "%zu");
+
+    /* running out is an allocation failure like any other */
+    ls_args_arena_init(&arena, buf, 256);
+    ls_args_init(&args);
+    ls_args_set_allocator(&args, &allocator);
+    for (i = 0; i < N; ++i) {
+        if (!ls_args_bool(&args, &vals[i], NULL, names[i], "Generated", 0)) {
+            break;
+        }
+    }
+    ASSERT(i < N);
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_ALLOC, "%d");
+    ASSERT_EQ(args.args_len, (size_t)i, "%zu");
+    return 0;
+}
+
+/* checks that every size handed to the allocator is the one it allocated */
+typedef struct tracked {
+    void* ptrs[64];
+    size_t sizes[64];
+    size_t live;
+    int mismatches;
+} tracked;
+
+static size_t tracked_find(tracked* t, void* p) {
+    size_t i;
+    for (i = 0; i < 64; ++i) {
+        if (t->ptrs[i] == p) {
+            return i;
+        }
+    }
+    return 64;
+}
+
+static void* tracked_resize(void* user, void* p, size_t old, size_t size) {
+    tracked* t = (tracked*)user;
+    size_t i = tracked_find(t, p);
+    void* res;
+    if (p != NULL) {
+        if (i == 64 || t->sizes[i] != old) {
+            t->mismatches += 1;
+            return NULL;
+        }
+    } else {
+        i = tracked_find(t, NULL);
+        if (i == 64) {
+            return NULL;
+        }
+    }
+    res = realloc(p, size);
+    if (res == NULL) {
+        return NULL;
+    }
+    t->live += size - old;
+    t->ptrs[i] = res;
+    t->sizes[i] = size;
+    return res;
+}
+
+static void tracked_release(void* user, void* p, size_t size) {
+    tracked* t = (tracked*)user;
+    size_t i = tracked_find(t, p);
+    if (i == 64 || t->sizes[i] != size) {
+        t->mismatches += 1;
+        return;
+    }
+    t->live -= size;
+    t->ptrs[i] = NULL;
+    free(p);
+}
+
+TEST_CASE(custom_allocator_sizes) {
+    static char names[40][16];
+    static int vals[40];
+    const char* input = NULL;
+    tracked t;
+    ls_args_allocator allocator;
+    ls_args args;
+    ls_args_ctx ctx;
+    char* argv[] = { "./program", "--opt3", "in", NULL };
+    int i;
+
+    memset(&t, 0, sizeof(t));
+    allocator.resize = tracked_resize;
+    allocator.release = tracked_release;
+    allocator.user = &t;
+    alloc_count = 0;
+    ls_args_init(&args);
+    ls_args_set_allocator(&args, &allocator);
+    for (i = 0; i < 40; ++i) {
+        sprintf(names[i], "opt%d", i);
+        ASSERT(ls_args_bool(&args, &vals[i], NULL, names[i], "Generated", 0));
+    }
+    for (i = 0; i < 12; ++i) {
+        ASSERT(ls_args_pos_string(&args, &input, "input", 0));
+    }
+    ASSERT(ls_args_help(&args) != NULL);
+    ASSERT(ls_args_help(&args) != NULL);
+    ASSERT(ls_args_compile(&args));
+    ASSERT(ls_args_parse(&args, 3, argv));
+    ASSERT(ls_args_ctx_init(&ctx, &args, NULL, NULL));
+    ls_args_ctx_free(&ctx);
+    ASSERT(t.live > 0);
+    ls_args_free(&args);
+    ASSERT_EQ(t.mismatches, 0, "%d");
+    ASSERT_EQ(t.live, 0, "%zu");
+    ASSERT_EQ(alloc_count, 0, "%d");
+    return 0;
+}
+
+TEST_CASE(long_prefixes_and_extensions) {
+    static const char* names[] = { "a", "ab", "abc", "abcd", "abd", "b" };
+    static const char* misses[] = { "abcde", "ac", "abce", "ba", "bb", "A" };
+    int vals[6];
+    ls_args args;
+    char arg[16];
+    char* argv[] = { "./program", arg, NULL };
+    int i, compiled;
+
+    /* one pointer per name, the value and help, plus three bytes */
+    ASSERT(sizeof(ls_args_arg) <= 5 * sizeof(void*));
+    ls_args_init(&args);
+    for (i = 0; i < 6; ++i) {
+        ASSERT(ls_args_bool(&args, &vals[i], NULL, names[i], "Generated", 0));
+    }
+    for (compiled = 0; compiled < 2; ++compiled) {
+        if (compiled) {
+            ASSERT(ls_args_compile(&args));
+        }
+        for (i = 0; i < 6; ++i) {
+            int k;
+            memset(vals, 0, sizeof(vals));
+            sprintf(arg, "--%s", names[i]);
+            ASSERT(ls_args_parse(&args, 2, argv));
+            for (k = 0; k < 6; ++k) {
+                ASSERT_EQ(vals[k], k == i, "%d");
+            }
+            sprintf(arg, "--%s", misses[i]);
+            ASSERT(!ls_args_parse(&args, 2, argv));
+            ASSERT_EQ(args.error.code, LS_ARGS_ERR_UNKNOWN_LONG, "%d");
+        }
+    }
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(iter_walks_without_writing) {
+    int verbose = 0;
+    int quiet = 0;
+    const char* out = NULL;
+    const char* in = NULL;
+    ls_args_rest rest = { NULL, 0 };
+    ls_args args;
+    ls_args_iter it;
+    char* argv[] = { "./program", "-vq", "--out", "o.txt", "in", "a", "-o",
+        "x", "--", "-b", NULL };
+    char* copy[10];
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+    ls_args_init(&args);
+    ASSERT(ls_args_bool(&args, &verbose, "v", "verbose", "Verbose", 0));
+    ASSERT(ls_args_bool(&args, &quiet, "q", "quiet", "Quiet", 0));
+    ASSERT(ls_args_string(&args, &out, "o", "out", "Output", 0));
+    ASSERT(ls_args_pos_string(&args, &in, "input", LS_ARGS_REQUIRED));
+    ASSERT(ls_args_pos_rest(&args, &rest, "files", 0));
+    memcpy(copy, argv, sizeof(copy));
+
+    ls_args_iter_init(&it, &args, argc, argv);
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_OPTION, "%d");
+    ASSERT(it.arg->val_ptr == &verbose);
+    ASSERT_EQ(it.arg_index, 0L, "%ld");
+    ASSERT_EQ(it.argv_index, 1, "%d");
+    ASSERT(it.value == NULL);
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_OPTION, "%d");
+    ASSERT(it.arg->val_ptr == &quiet);
+    ASSERT_EQ(it.argv_index, 1, "%d");
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_OPTION, "%d");
+    ASSERT_EQ(it.arg_index, 2L, "%ld");
+    ASSERT_STR_EQ(it.value, "o.txt");
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_POSITIONAL, "%d");
+    ASSERT(it.arg->val_ptr == &in);
+    ASSERT_STR_EQ(it.value, "in");
+    ASSERT_EQ(it.argv_index, 4, "%d");
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_POSITIONAL, "%d");
+    ASSERT(it.arg->val_ptr == &rest);
+    ASSERT_STR_EQ(it.value, "a");
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_OPTION, "%d");
+    ASSERT_STR_EQ(it.value, "x");
+    /* after `--`, options are positionals */
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_POSITIONAL, "%d");
+    ASSERT(it.arg->val_ptr == &rest);
+    ASSERT_STR_EQ(it.value, "-b");
+    ASSERT_EQ(it.argv_index, 9, "%d");
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_END, "%d");
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_END, "%d");
+    ASSERT(it.arg == NULL);
+
+    /* nothing was written */
+    ASSERT_EQ(verbose + quiet, 0, "%d");
+    ASSERT(out == NULL && in == NULL && rest.begin == NULL);
+    ASSERT(memcmp(copy, argv, sizeof(copy)) == 0);
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(iter_stops_early_and_errors) {
+    int help = 0;
+    const char* out = NULL;
+    const char* cmd = NULL;
+    ls_args args;
+    ls_args_iter it;
+    char* sub[] = { "./program", "--help", "run", "--bogus", NULL };
+    char* cluster[] = { "./program", "-oh", "x", NULL };
+    char* value[] = { "./program", "-o", "--help", NULL };
+    char* last[] = { "./program", "run", "-o", NULL };
+    char* extra[] = { "./program", "run", "more", NULL };
+    char** cases[] = { cluster, value, last, extra };
+    ls_args_error_code codes[] = { LS_ARGS_ERR_MISSING_VALUE,
+        LS_ARGS_ERR_MISSING_VALUE, LS_ARGS_ERR_MISSING_VALUE,
+        LS_ARGS_ERR_UNEXPECTED };
+    int i;
+
+    ls_args_init(&args);
+    ASSERT(ls_args_bool(&args, &help, "h", "help", "Help", 0));
+    ASSERT(ls_args_string(&args, &out, "o", "out", "Output", 0));
+    ASSERT(ls_args_pos_string(&args, &cmd, "command", LS_ARGS_REQUIRED));
+
+    /* the unknown option after the subcommand is never looked at */
+    ls_args_iter_init(&it, &args, 4, sub);
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_OPTION, "%d");
+    ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_POSITIONAL, "%d");
+    ASSERT_STR_EQ(it.value, "run");
+
+    /* errors are the ones `ls_args_parse` reports, and they stick */
+    for (i = 0; i < 4; ++i) {
+        ls_args_item item;
+        ls_args_iter_init(&it, &args, 3, cases[i]);
+        while ((item = ls_args_next(&it)) != LS_ARGS_ITEM_ERROR) {
+            ASSERT(item != LS_ARGS_ITEM_END);
+        }
+        ASSERT_EQ(ls_args_next(&it), LS_ARGS_ITEM_ERROR, "%d");
+        ASSERT(!ls_args_parse(&args, 3, cases[i]));
+        ASSERT_EQ(it.error.code, codes[i], "%d");
+        ASSERT_EQ(it.error.code, args.error.code, "%d");
+        ASSERT_EQ(it.error.argv_index, args.error.argv_index, "%d");
+        ASSERT_EQ(it.error.arg_index, args.error.arg_index, "%ld");
+        ASSERT_STR_EQ(ls_args_iter_error(&it), ls_args_error(&args));
+    }
+    ls_args_free(&args);
+    return 0;
+}
+
+/* Records every event as a line like `o0@1` (option, argument 0, argv[1]),
+ * `v2=x@3` (value) or `p3=in@4` (positional) */
+typedef struct event_log {
+    char text[512];
+    int abort_at;
+    int errors;
+    ls_args_error_code error_code;
+} event_log;
+
+static int log_event(event_log* log, char kind, long arg_index,
+    const char* value, int argv_index) {
+    char* end = log->text + strlen(log->text);
+    if (value != NULL) {
+        sprintf(end, "%c%ld=%s@%d ", kind, arg_index, value, argv_index);
+    } else {
+        sprintf(end, "%c%ld@%d ", kind, arg_index, argv_index);
+    }
+    return argv_index != log->abort_at;
+}
+
+static int on_option(
+    void* user, const ls_args_arg* arg, long arg_index, int argv_index) {
+    (void)arg;
+    return log_event(user, 'o', arg_index, NULL, argv_index);
+}
+
+static int on_value(void* user, const ls_args_arg* arg, long arg_index,
+    const char* value, int argv_index) {
+    (void)arg;
+    return log_event(user, 'v', arg_index, value, argv_index);
+}
+
+static int on_positional(void* user, const ls_args_arg* arg, long arg_index,
+    const char* value, int argv_index) {
+    (void)arg;
+    return log_event(user, 'p', arg_index, value, argv_index);
+}
+
+static void on_error(void* user, const ls_args_error_info* error) {
+    event_log* log = user;
+    log->errors += 1;
+    log->error_code = error->code;
+}
+
+TEST_CASE(parse_events) {
+    int verbose = 0;
+    const char* out = NULL;
+    const char* in = NULL;
+    ls_args_rest rest = { NULL, 0 };
+    ls_args args;
+    ls_args_ctx ctx;
+    ls_args_events events;
+    event_log log;
+    char* argv[] = { "./program", "a", "-vo", "x", "b", "--verbose", "--",
+        "-c", NULL };
+    char* missing[] = { "./program", "-v", NULL };
+    char* copy[9];
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+    ls_args_init(&args);
+    ASSERT(ls_args_bool(&args, &verbose, "v", "verbose", "Verbose", 0));
+    ASSERT(ls_args_string(&args, &out, "o", "out", "Output", 0));
+    ASSERT(ls_args_pos_string(&args, &in, "input", LS_ARGS_REQUIRED));
+    ASSERT(ls_args_pos_rest(&args, &rest, "files", 0));
+    memcpy(copy, argv, sizeof(copy));
+    memset(&events, 0, sizeof(events));
+    memset(&log, 0, sizeof(log));
+    log.abort_at = -1;
+    events.user = &log;
+    events.option = on_option;
+    events.value = on_value;
+    events.positional = on_positional;
+    events.error = on_error;
+
+    ASSERT(ls_args_parse_events(&args, argc, argv, &events));
+    ASSERT_STR_EQ((const char*)log.text,
+        "p2=a@1 o0@2 o1@2 v1=x@3 p3=b@4 o0@5 p3=-c@7 ");
+    /* nothing was written, and argv wasn't reordered for the rest */
+    ASSERT(verbose == 0 && out == NULL && in == NULL && rest.begin == NULL);
+    ASSERT(memcmp(copy, argv, sizeof(copy)) == 0);
+    ASSERT_EQ(log.errors, 0, "%d");
+
+    /* a callback stops the parse right there */
+    log.text[0] = '\0';
+    log.abort_at = 3;
+    ASSERT(!ls_args_parse_events(&args, argc, argv, &events));
+    ASSERT_STR_EQ((const char*)log.text, "p2=a@1 o0@2 o1@2 v1=x@3 ");
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_ABORTED, "%d");
+    ASSERT_EQ(args.error.arg_index, 1L, "%ld");
+    ASSERT_STR_EQ(ls_args_error(&args), "Parsing aborted");
+    ASSERT_EQ(log.errors, 0, "%d");
+
+    /* other errors go to the error callback, with contexts too */
+    ls_args_freeze(&args);
+    ASSERT(ls_args_ctx_init(&ctx, &args, NULL, NULL));
+    log.abort_at = -1;
+    ASSERT(!ls_args_ctx_parse_events(&ctx, 2, missing, &events));
+    ASSERT_EQ(log.errors, 1, "%d");
+    ASSERT_EQ(log.error_code, LS_ARGS_ERR_REQUIRED, "%d");
+    ASSERT_EQ(ctx.error.code, LS_ARGS_ERR_REQUIRED, "%d");
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(validate) {
+    int verbose = 0;
+    const char* out = NULL;
+    const char* in = NULL;
+    ls_args_rest rest = { NULL, 0 };
+    ls_args args;
+    ls_args_error_info err;
+    char msg[LS_ARGS_ERROR_MAX];
+    char* argv[] = { "./program", "a", "-vo", "x", "b", "--verbose", NULL };
+    char* unknown[] = { "./program", "a", "-vx", NULL };
+    char* missing[] = { "./program", "-v", NULL };
+    char* copy[7];
+    int allocs;
+
+    ls_args_init(&args);
+    ASSERT(ls_args_bool(&args, &verbose, "v", "verbose", "Verbose", 0));
+    ASSERT(ls_args_string(&args, &out, "o", "out", "Output", 0));
+    ASSERT(ls_args_pos_string(&args, &in, "input", LS_ARGS_REQUIRED));
+    ASSERT(ls_args_pos_rest(&args, &rest, "files", 0));
+    ls_args_freeze(&args);
+    memcpy(copy, argv, sizeof(copy));
+    allocs = alloc_count;
+
+    ASSERT(ls_args_validate(&args, 6, argv, &err));
+    ASSERT_EQ(err.code, LS_ARGS_OK, "%d");
+    /* nothing was written or allocated, and argv is as it was */
+    ASSERT(verbose == 0 && out == NULL && in == NULL && rest.begin == NULL);
+    ASSERT(memcmp(copy, argv, sizeof(copy)) == 0);
+    ASSERT_EQ(alloc_count, allocs, "%d");
+
+    ASSERT(!ls_args_validate(&args, 3, unknown, &err));
+    ASSERT_EQ(err.code, LS_ARGS_ERR_UNKNOWN_SHORT, "%d");
+    ASSERT_EQ(err.argv_index, 2, "%d");
+    ASSERT(!ls_args_validate(&args, 2, missing, &err));
+    ASSERT_EQ(err.code, LS_ARGS_ERR_REQUIRED, "%d");
+    ASSERT_EQ(err.arg_index, 2L, "%ld");
+    /* the same message as the parse gives */
+    ls_args_format_error(&args, &err, msg);
+    ASSERT(!ls_args_parse(&args, 2, missing));
+    ASSERT_STR_EQ((const char*)msg, ls_args_error(&args));
+    ASSERT_EQ(alloc_count, allocs, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(validate_too_many) {
+    static int flags[LS_ARGS_VALIDATE_MAX + 1];
+    ls_args args;
+    ls_args_error_info err;
+    char* argv[] = { "./program", NULL };
+    size_t i;
+
+    ls_args_init(&args);
+    for (i = 0; i <= LS_ARGS_VALIDATE_MAX; ++i) {
+        ASSERT(ls_args_bool(&args, &flags[i], NULL, "flag", "Flag", 0));
+    }
+    ls_args_freeze(&args);
+    ASSERT(!ls_args_validate(&args, 1, argv, &err));
+    ASSERT_EQ(err.code, LS_ARGS_ERR_TOO_MANY, "%d");
+    ASSERT_EQ(err.argv_index, -1, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(ctx_reset) {
+    struct opts {
+        int force;
+        const char* name;
+    } layout, mine;
+    ls_args spec;
+    ls_args_ctx ctx;
+    char* good[] = { "./daemon", "-f", "--name", "x", NULL };
+    char* missing[] = { "./daemon", "-f", NULL };
+    int allocs;
+
+    ls_args_init(&spec);
+    ASSERT(ls_args_bool(&spec, &layout.force, "f", "force", "Force", 0));
+    ASSERT(ls_args_string(
+        &spec, &layout.name, "n", "name", "Name", LS_ARGS_REQUIRED));
+    ls_args_freeze(&spec);
+    ASSERT(ls_args_ctx_init(&ctx, &spec, &mine, &layout));
+    allocs = alloc_count;
+
+    memset(&mine, 0, sizeof(mine));
+    ASSERT(ls_args_ctx_parse(&ctx, 4, good));
+    ASSERT(mine.force == 1 && strcmp(mine.name, "x") == 0);
+    /* the next parse doesn't see what the last one found */
+    ASSERT(!ls_args_ctx_parse(&ctx, 2, missing));
+    ASSERT_EQ(ctx.error.code, LS_ARGS_ERR_REQUIRED, "%d");
+    ls_args_ctx_reset(&ctx);
+    ASSERT_EQ(ctx.error.code, LS_ARGS_OK, "%d");
+    ASSERT(ctx.program_name == NULL);
+    ASSERT_STR_EQ(ls_args_ctx_error(&ctx), "Success");
+
+    /* across the wrap-around of the epoch too */
+    ctx._epoch = (unsigned)-2;
+    ASSERT(ls_args_ctx_parse(&ctx, 4, good));
+    ASSERT(ls_args_ctx_parse(&ctx, 4, good));
+    ASSERT_EQ(ctx._epoch, 1u, "%u");
+    ASSERT(!ls_args_ctx_parse(&ctx, 2, missing));
+    ASSERT_EQ(alloc_count, allocs, "%d");
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&spec);
+    return 0;
+}
+
+TEST_CASE(ctx_parse_buffer) {
+    struct opts {
+        int verbose;
+        const char* out;
+        ls_args_rest files;
+    } layout, mine;
+    ls_args spec;
+    ls_args_ctx ctx;
+    char cmdline[] = "/bin/tool\0-v\0--out\0o.txt\0a\0b";
+    char big[200 * 2 + 16];
+    char unterminated[] = { 't', 0, '-', 'v' };
+    int allocs;
+    size_t i;
+
+    ls_args_init(&spec);
+    ASSERT(ls_args_bool(&spec, &layout.verbose, "v", "verbose", "Verbose", 0));
+    ASSERT(ls_args_string(&spec, &layout.out, "o", "out", "Output", 0));
+    ASSERT(ls_args_pos_rest(&spec, &layout.files, "files", 0));
+    ls_args_freeze(&spec);
+    ASSERT(ls_args_ctx_init(&ctx, &spec, &mine, &layout));
+
+    /* the literal's own NUL terminates the last one */
+    memset(&mine, 0, sizeof(mine));
+    ASSERT(ls_args_ctx_parse_buffer(&ctx, cmdline, sizeof(cmdline)));
+    ASSERT_STR_EQ(ctx.program_name, "/bin/tool");
+    ASSERT_EQ(mine.verbose, 1, "%d");
+    ASSERT(mine.out == cmdline + 19);
+    ASSERT_EQ(mine.files.count, (size_t)2, "%zu");
+    ASSERT(mine.files.begin[0] == cmdline + 25);
+    ASSERT_STR_EQ(mine.files.begin[1], "b");
+
+    /* a long one grows the argv, shorter ones after it don't allocate */
+    memcpy(big, "big", 4);
+    for (i = 0; i < 200; ++i) {
+        memcpy(big + 4 + i * 2, "x", 2);
+    }
+    memset(&mine, 0, sizeof(mine));
+    ASSERT(ls_args_ctx_parse_buffer(&ctx, big, 4 + 200 * 2));
+    ASSERT_EQ(mine.files.count, (size_t)200, "%zu");
+    allocs = alloc_count;
+    for (i = 0; i < 10; ++i) {
+        ASSERT(ls_args_ctx_parse_buffer(&ctx, cmdline, sizeof(cmdline)));
+    }
+    ASSERT_EQ(alloc_count, allocs, "%d");
+
+    /* nothing at all, and a last argument without its NUL */
+    ASSERT(ls_args_ctx_parse_buffer(&ctx, cmdline, 0));
+    ASSERT(ctx.program_name == NULL);
+    ASSERT(!ls_args_ctx_parse_buffer(&ctx, unterminated, 4));
+    ASSERT_EQ(ctx.error.code, LS_ARGS_ERR_INVALID, "%d");
+    ASSERT_EQ(ctx.error.argv_index, 1, "%d");
+
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&spec);
+    return 0;
+}
+
+/* Writes `len` bytes of `data` to a new temporary file, whose name is put into
+ * `path`, which must hold at least 32 bytes */
+static int write_temp(char* path, const char* data, size_t len) {
+    int fd;
+    strcpy(path, "/tmp/ls_args_test_XXXXXX");
+    fd = mkstemp(path);
+    if (fd < 0) {
+        return 0;
+    }
+    if (write(fd, data, len) != (ssize_t)len) {
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    return 1;
+}
+
+TEST_CASE(ctx_parse_response) {
+    int verbose = 0;
+    const char* out = NULL;
+    ls_args_rest files = { NULL, 0 };
+    ls_args spec;
+    ls_args_ctx ctx;
+    char inner_path[32], outer_path[32], self_path[32], quote_path[32];
+    char outer[128], self[64], inner_arg[40], outer_arg[40], self_arg[40];
+    char quote_arg[40];
+    char* argv[] = { "./program", "first", outer_arg, "-v", NULL };
+    char* nested[] = { "./program", self_arg, NULL };
+    char* missing[] = { "./program", "@/nonexistent/ls_args", NULL };
+    char* broken[] = { "./program", quote_arg, NULL };
+    FILE* f;
+    const char* inner = "  'two words'\t\"a \\\"b\\\"\" c\\ d\n  last";
+
+    ls_args_init(&spec);
+    ASSERT(ls_args_bool(&spec, &verbose, "v", "verbose", "Verbose", 0));
+    ASSERT(ls_args_string(&spec, &out, "o", "out", "Output", 0));
+    ASSERT(ls_args_pos_rest(&spec, &files, "files", 0));
+    ls_args_freeze(&spec);
+    ASSERT(ls_args_ctx_init(&ctx, &spec, NULL, NULL));
+
+    ASSERT(write_temp(inner_path, inner, strlen(inner)));
+    sprintf(inner_arg, "@%s", inner_path);
+    sprintf(outer, "--out o.txt\n%s\nmid", inner_arg);
+    ASSERT(write_temp(outer_path, outer, strlen(outer)));
+    sprintf(outer_arg, "@%s", outer_path);
+    ASSERT(ls_args_ctx_parse_response(
+        &ctx, 4, argv, LS_ARGS_RESPONSE_QUOTES));
+    ASSERT_EQ(verbose, 1, "%d");
+    ASSERT_STR_EQ(out, "o.txt");
+    ASSERT_EQ(files.count, (size_t)6, "%zu");
+    ASSERT_STR_EQ(files.begin[0], "first");
+    ASSERT_STR_EQ(files.begin[1], "two words");
+    ASSERT_STR_EQ(files.begin[2], "a \"b\"");
+    ASSERT_STR_EQ(files.begin[3], "c d");
+    ASSERT_STR_EQ(files.begin[4], "last");
+    ASSERT_STR_EQ(files.begin[5], "mid");
+
+    /* without quoting, quotes are part of the arguments */
+    verbose = 0;
+    ASSERT(ls_args_ctx_parse_response(&ctx, 4, argv, 0));
+    ASSERT_STR_EQ(files.begin[1], "'two");
+
+    /* a file which names itself ends at the depth limit */
+    ASSERT(write_temp(self_path, "", 0));
+    sprintf(self_arg, "@%s", self_path);
+    sprintf(self, "x %s", self_arg);
+    f = fopen(self_path, "w");
+    ASSERT(f != NULL);
+    fputs(self, f);
+    fclose(f);
+    ASSERT(!ls_args_ctx_parse_response(&ctx, 2, nested, 0));
+    ASSERT_EQ(ctx.error.code, LS_ARGS_ERR_RESPONSE, "%d");
+    ASSERT_EQ(errno, ELOOP, "%d");
+    ASSERT_EQ(ctx.error.argv_index, LS_ARGS_RESPONSE_DEPTH + 1, "%d");
+
+    ASSERT(!ls_args_ctx_parse_response(&ctx, 2, missing, 0));
+    ASSERT_EQ(errno, ENOENT, "%d");
+    ASSERT_STR_EQ(ls_args_ctx_error(&ctx),
+        "Invalid response file '/nonexistent/ls_args'");
+
+    ASSERT(write_temp(quote_path, "'open", 5));
+    sprintf(quote_arg, "@%s", quote_path);
+    ASSERT(!ls_args_ctx_parse_response(
+        &ctx, 2, broken, LS_ARGS_RESPONSE_QUOTES));
+    ASSERT_EQ(errno, EINVAL, "%d");
+
+    unlink(inner_path);
+    unlink(outer_path);
+    unlink(self_path);
+    unlink(quote_path);
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&spec);
+    return 0;
+}
+
+TEST_CASE(ctx_parse_response_nul_separated) {
+    ls_args_rest files = { NULL, 0 };
+    ls_args spec;
+    ls_args_ctx ctx;
+    char path[32], arg[40];
+    char* argv[] = { "./program", arg, "@", NULL };
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char* data = malloc(page);
+    size_t i;
+
+    ls_args_init(&spec);
+    ASSERT(ls_args_pos_rest(&spec, &files, "files", 0));
+    ls_args_freeze(&spec);
+    ASSERT(ls_args_ctx_init(&ctx, &spec, NULL, NULL));
+
+    /* a whole page of `xxxxxxx\0`, but the last one has no NUL, so it's the
+     * one that has to be copied */
+    ASSERT(data != NULL);
+    for (i = 0; i < page; ++i) {
+        data[i] = i % 8 == 7 ? '\0' : 'x';
+    }
+    data[page - 1] = 'y';
+    ASSERT(write_temp(path, data, page));
+    sprintf(arg, "@%s", path);
+    ASSERT(ls_args_ctx_parse_response(&ctx, 3, argv, LS_ARGS_RESPONSE_NUL));
+    /* a lone `@` is just an argument */
+    ASSERT_EQ(files.count, page / 8 + 1, "%zu");
+    ASSERT_STR_EQ(files.begin[0], "xxxxxxx");
+    ASSERT_STR_EQ(files.begin[page / 8 - 1], "xxxxxxxy");
+    ASSERT_STR_EQ(files.begin[page / 8], "@");
+
+    unlink(path);
+    free(data);
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&spec);
+    return 0;
+}
+
+TEST_CASE(ctx_parse_response_pipe) {
+    ls_args_rest files = { NULL, 0 };
+    ls_args spec;
+    ls_args_ctx ctx;
+    char arg[40];
+    char* argv[] = { "./program", arg, NULL };
+    int fds[2];
+
+    ls_args_init(&spec);
+    ASSERT(ls_args_pos_rest(&spec, &files, "files", 0));
+    ls_args_freeze(&spec);
+    ASSERT(ls_args_ctx_init(&ctx, &spec, NULL, NULL));
+
+    /* a pipe has no size, but isn't empty */
+    ASSERT(pipe(fds) == 0);
+    ASSERT(write(fds[1], "a b", 3) == 3);
+    sprintf(arg, "@/dev/fd/%d", fds[0]);
+    errno = 0;
+    ASSERT(!ls_args_ctx_parse_response(&ctx, 2, argv, 0));
+    ASSERT_EQ(ctx.error.code, LS_ARGS_ERR_RESPONSE, "%d");
+    ASSERT_EQ(errno, EINVAL, "%d");
+    ASSERT_EQ(ctx.error.argv_index, 1, "%d");
+
+    close(fds[0]);
+    close(fds[1]);
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&spec);
+    return 0;
+}
+
+static int count_positional(void* user, const ls_args_arg* arg,
+    long arg_index, const char* value, int argv_index) {
+    size_t* count = user;
+    (void)arg;
+    (void)arg_index;
+    (void)argv_index;
+    *count += strcmp(value, "some/path/to/a/file.c") == 0;
+    return 1;
+}
+
+TEST_CASE(read_positionals) {
+    ls_args_rest files = { NULL, 0 };
+    ls_args args;
+    ls_args no_rest;
+    ls_args_events events;
+    event_log log;
+    char buf[8];
+    char big[64];
+    char path[32];
+    int fds[2];
+    int fd;
+    size_t count = 0;
+    size_t i;
+    FILE* f;
+
+    ls_args_init(&args);
+    ASSERT(ls_args_pos_rest(&args, &files, "files", 0));
+    memset(&events, 0, sizeof(events));
+    memset(&log, 0, sizeof(log));
+    /* streamed ones are at -1 */
+    log.abort_at = INT_MAX;
+    events.user = &log;
+    events.positional = on_positional;
+
+    /* a buffer that's barely large enough for the longest one; empty ones
+     * are skipped, and the last one needs no terminator */
+    ASSERT(pipe(fds) == 0);
+    ASSERT(write(fds[1], "a\0bbbbbbb\0\0ccc", 14) == 14);
+    close(fds[1]);
+    ASSERT(ls_args_read_positionals(
+        &args, fds[0], buf, sizeof(buf), LS_ARGS_STREAM_NUL, &events));
+    close(fds[0]);
+    ASSERT_STR_EQ((const char*)log.text, "p0=a@-1 p0=bbbbbbb@-1 p0=ccc@-1 ");
+
+    /* one more byte doesn't fit */
+    ASSERT(pipe(fds) == 0);
+    ASSERT(write(fds[1], "a\nbbbbbbbb\n", 11) == 11);
+    close(fds[1]);
+    log.text[0] = '\0';
+    ASSERT(!ls_args_read_positionals(&args, fds[0], buf, 8, 0, &events));
+    close(fds[0]);
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_STREAM, "%d");
+    ASSERT_EQ(errno, ENOBUFS, "%d");
+    ASSERT_STR_EQ((const char*)log.text, "p0=a@-1 ");
+
+    /* without a rest argument, there's nowhere for them to go */
+    ls_args_init(&no_rest);
+    ASSERT(pipe(fds) == 0);
+    ASSERT(write(fds[1], "x\n", 2) == 2);
+    close(fds[1]);
+    ASSERT(!ls_args_read_positionals(&no_rest, fds[0], buf, 8, 0, &events));
+    close(fds[0]);
+    ASSERT_STR_EQ(ls_args_error(&no_rest), "Unexpected argument 'x'");
+    ls_args_free(&no_rest);
+
+    /* many more than fit into the buffer at once, in constant memory */
+    ASSERT(write_temp(path, "", 0));
+    f = fopen(path, "w");
+    ASSERT(f != NULL);
+    for (i = 0; i < 100000; ++i) {
+        fputs("some/path/to/a/file.c\n", f);
+    }
+    fclose(f);
+    fd = open(path, O_RDONLY);
+    ASSERT(fd >= 0);
+    events.user = &count;
+    events.positional = count_positional;
+    alloc_count = 0;
+    ASSERT(ls_args_read_positionals(&args, fd, big, sizeof(big), 0, &events));
+    ASSERT_EQ(count, (size_t)100000, "%zu");
+    ASSERT_EQ(alloc_count, 0, "%d");
+    close(fd);
+    unlink(path);
+
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(split_and_parse_string) {
+    int verbose = 0;
+    const char* out = NULL;
+    ls_args_rest files = { NULL, 0 };
+    ls_args args;
+    char line[] = "  /bin/job -v --out 'my file'   a\\ b \"say \\\"hi\\\"\" ''x\t";
+    char words[] = "one 'two three' four";
+    char open_quote[] = "prog 'oops";
+    char too_many[] = "prog a b c d";
+    char* argv[4];
+
+    ASSERT_EQ(ls_args_split(words, argv, 4), 3, "%d");
+    ASSERT_STR_EQ(argv[0], "one");
+    ASSERT_STR_EQ(argv[1], "two three");
+    ASSERT_STR_EQ(argv[2], "four");
+
+    ls_args_init(&args);
+    ASSERT(ls_args_bool(&args, &verbose, "v", "verbose", "Verbose", 0));
+    ASSERT(ls_args_string(&args, &out, "o", "out", "Output", 0));
+    ASSERT(ls_args_pos_rest(&args, &files, "files", 0));
+    {
+        char* many[8];
+        ASSERT(ls_args_parse_string(&args, line, many, 8));
+        ASSERT_STR_EQ(args.program_name, "/bin/job");
+        ASSERT_EQ(verbose, 1, "%d");
+        ASSERT_STR_EQ(out, "my file");
+        ASSERT_EQ(files.count, (size_t)3, "%zu");
+        ASSERT_STR_EQ(files.begin[0], "a b");
+        ASSERT_STR_EQ(files.begin[1], "say \"hi\"");
+        ASSERT_STR_EQ(files.begin[2], "x");
+        /* values point into the string */
+        ASSERT(out > line && out < line + sizeof(line));
+    }
+
+    ASSERT(!ls_args_parse_string(&args, open_quote, argv, 4));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_INVALID, "%d");
+    ASSERT_EQ(args.error.argv_index, 1, "%d");
+    ASSERT(!ls_args_parse_string(&args, too_many, argv, 4));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_UNEXPECTED, "%d");
+    ASSERT_STR_EQ(ls_args_error(&args), "Unexpected argument 'd'");
+    ls_args_free(&args);
+    return 0;
+}
+
+#ifdef LS_ARGS_PTHREAD
+TEST_CASE(parse_batch) {
+    enum { COUNT = 20000, TEMPLATES = 6 };
+    static ls_args_batch_input inputs[COUNT];
+    static ls_args_batch_result results[COUNT];
+    static int bound[COUNT * 4];
+    static char long_record[2 + 400 * 2];
+    static char* long_argv[401];
+    int verbose;
+    const char* out;
+    const char* in;
+    ls_args_rest rest;
+    ls_args spec;
+    ls_args_ctx ctx;
+    char* valid[] = { "./p", "-v", "in", "--out", "o", "-v", "a", "b" };
+    char* unknown[] = { "./p", "in", "--nope" };
+    char* missing[] = { "./p", "-v" };
+    char* no_value[] = { "./p", "in", "-o" };
+    char record[] = "./p\0--out\0x\0in";
+    int threads[] = { 4, 1, 0, 64 };
+    size_t i, t;
+
+    ls_args_init(&spec);
+    ASSERT(ls_args_bool(&spec, &verbose, "v", "verbose", "Verbose", 0));
+    ASSERT(ls_args_string(&spec, &out, "o", "out", "Output", 0));
+    ASSERT(ls_args_pos_string(&spec, &in, "input", LS_ARGS_REQUIRED));
+    ASSERT(ls_args_pos_rest(&spec, &rest, "files", 0));
+    ls_args_freeze(&spec);
+    ASSERT(ls_args_ctx_init(&ctx, &spec, NULL, NULL));
+
+    /* a long one every now and then, all near the start, for the stealing */
+    long_argv[0] = "./p";
+    for (i = 1; i < 401; ++i) {
+        long_argv[i] = "f";
+    }
+    memcpy(long_record, "p", 2);
+    for (i = 0; i < 400; ++i) {
+        memcpy(long_record + 2 + i * 2, "f", 2);
+    }
+    for (i = 0; i < COUNT; ++i) {
+        ls_args_batch_input* input = &inputs[i];
+        memset(input, 0, sizeof(*input));
+        switch (i < 2000 && i % 10 == 0 ? TEMPLATES : i % TEMPLATES) {
+        case 0:
+            input->argc = 8;
+            input->argv = valid;
+            break;
+        case 1:
+            input->argc = 3;
+            input->argv = unknown;
+            break;
+        case 2:
+            input->argc = 2;
+            input->argv = missing;
+            break;
+        case 3:
+            input->argc = 3;
+            input->argv = no_value;
+            break;
+        case 4:
+            input->record = record;
+            input->record_len = sizeof(record);
+            break;
+        case 5:
+            input->argc = 0;
+            input->argv = valid;
+            break;
+        default:
+            if (i % 20 == 0) {
+                input->argc = 401;
+                input->argv = long_argv;
+            } else {
+                input->record = long_record;
+                input->record_len = sizeof(long_record);
+            }
+            break;
+        }
+    }
+
+    for (t = 0; t < sizeof(threads) / sizeof(*threads); ++t) {
+        memset(results, 0xff, sizeof(results));
+        ASSERT(ls_args_parse_batch(
+            &spec, inputs, COUNT, results, bound, threads[t]));
+        for (i = 0; i < COUNT; ++i) {
+            int ok = inputs[i].argv != NULL
+                ? ls_args_ctx_parse(&ctx, inputs[i].argc, inputs[i].argv)
+                : ls_args_ctx_parse_buffer(
+                    &ctx, inputs[i].record, inputs[i].record_len);
+            ASSERT_EQ(results[i].ok, ok, "%d");
+            ASSERT_EQ(results[i].code, ctx.error.code, "%d");
+            ASSERT_EQ(results[i].argv_index, ctx.error.argv_index, "%d");
+            ASSERT_EQ(results[i].arg_index, ctx.error.arg_index, "%ld");
+        }
+    }
+    /* `-v in --out o -v a b`: the last -v, the value of --out, the input and
+     * the first of the rest */
+    ASSERT_EQ(bound[6 * 4 + 0], 5, "%d");
+    ASSERT_EQ(bound[6 * 4 + 1], 4, "%d");
+    ASSERT_EQ(bound[6 * 4 + 2], 2, "%d");
+    ASSERT_EQ(bound[6 * 4 + 3], 6, "%d");
+    /* the record, without -v and any rest */
+    ASSERT_EQ(bound[4 * 4 + 0], -1, "%d");
+    ASSERT_EQ(bound[4 * 4 + 1], 2, "%d");
+    ASSERT_EQ(bound[4 * 4 + 2], 3, "%d");
+    ASSERT_EQ(bound[4 * 4 + 3], -1, "%d");
+    /* the inputs are untouched, the rest isn't moved together */
+    ASSERT_STR_EQ(valid[5], "-v");
+
+    /* a record too long for the argv a thread has only fails itself */
+    inputs[0].argc = 0;
+    inputs[0].argv = NULL;
+    inputs[0].record = long_record;
+    inputs[0].record_len = sizeof(long_record);
+    inputs[1].argc = 0;
+    inputs[1].argv = NULL;
+    inputs[1].record = record;
+    inputs[1].record_len = sizeof(record);
+    /* below the argv the long record needs, above a worker and its error
+     * buffer however large LS_ARGS_ERROR_MAX is */
+    alloc_limit = (int)(sizeof(long_argv) - sizeof(*long_argv));
+    ASSERT(ls_args_parse_batch(&spec, inputs, 2, results, NULL, 1));
+    alloc_limit = -1;
+    ASSERT_EQ(results[0].ok, 0, "%d");
+    ASSERT_EQ(results[0].code, LS_ARGS_ERR_ALLOC, "%d");
+    ASSERT_EQ(results[1].ok, 1, "%d");
+
+    ls_args_ctx_free(&ctx);
+    ls_args_free(&spec);
+    return 0;
+}
+#endif
+
+TEST_CASE(numeric_options) {
+    int64_t offset = 7;
+    uint64_t size = 7;
+    double ratio = 7.0;
+    ls_args args;
+    ls_args_error_info err;
+    char* argv[] = { "./program", "--offset", "-9223372036854775808", "-s",
+        "0018446744073709551615", "-r", "-.5", NULL };
+    char* bad[] = { "./program", "-s", "1", "--offset", "12a", NULL };
+    char* values[] = { "9223372036854775807", "9223372036854775808", "-1",
+        "+5", " 1", "0x10", "", "1e5" };
+    int codes[] = { LS_ARGS_OK, LS_ARGS_ERR_RANGE, LS_ARGS_OK, LS_ARGS_OK,
+        LS_ARGS_ERR_NUMBER, LS_ARGS_ERR_NUMBER, LS_ARGS_ERR_MISSING_VALUE,
+        LS_ARGS_ERR_NUMBER };
+    char* one[] = { "./program", "--offset", NULL, NULL };
+    size_t i;
+
+    ls_args_init(&args);
+    ASSERT(ls_args_int64(&args, &offset, "o", "offset", "Offset", 0));
+    ASSERT(ls_args_uint64(&args, &size, "s", "size", "Size", 0));
+    ASSERT(ls_args_double(&args, &ratio, "r", "ratio", "Ratio", 0));
+    ASSERT(ls_args_parse(&args, 7, argv));
+    /* negative values aren't mistaken for options */
+    ASSERT(offset == INT64_MIN);
+    ASSERT(size == UINT64_MAX);
+    ASSERT(ratio == -0.5);
+
+    /* the value at fault, with the option it belongs to */
+    offset = 7;
+    ASSERT(!ls_args_parse(&args, 5, bad));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_NUMBER, "%d");
+    ASSERT_EQ(args.error.argv_index, 4, "%d");
+    ASSERT_EQ(args.error.arg_index, 0L, "%ld");
+    ASSERT_STR_EQ(args.last_error, "Invalid number");
+    ASSERT_STR_EQ(ls_args_error(&args), "Invalid number '12a' for '--offset'");
+    ASSERT(offset == 7 && size == 1);
+
+    for (i = 0; i < sizeof(values) / sizeof(*values); ++i) {
+        one[2] = values[i];
+        ASSERT_EQ((int)ls_args_parse(&args, 3, one), codes[i] == LS_ARGS_OK,
+            "%d");
+        ASSERT_EQ((int)args.error.code, codes[i], "%d");
+    }
+    ASSERT(offset == 5);
+    one[2] = "9223372036854775808";
+    ASSERT(!ls_args_parse(&args, 3, one));
+    ASSERT_STR_EQ(ls_args_error(&args),
+        "Number '9223372036854775808' out of range for '--offset'");
+    one[1] = "--size";
+    one[2] = "-1";
+    ASSERT(!ls_args_parse(&args, 3, one));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_RANGE, "%d");
+
+    /* validation converts too, without storing */
+    ls_args_freeze(&args);
+    ASSERT(!ls_args_validate(&args, 5, bad, &err));
+    ASSERT_EQ(err.code, LS_ARGS_ERR_NUMBER, "%d");
+    ASSERT_EQ(err.argv_index, 4, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+TEST_CASE(double_conversion) {
+    double ratio;
+    ls_args args;
+    char* one[] = { "./program", "-r", NULL, NULL };
+    char* values[] = { "0", "-0.0", "1", "0.1", ".5", "5.", "123.456e-2",
+        "1E22", "1e23", "9007199254740993", "123456789012345678901234",
+        "0.000000000000000000000000000001", "2.2250738585072014e-308",
+        "4.9e-324", "1e-400", "1.7976931348623157e308", "1e+0000000000000001",
+        NULL };
+    char* bad[] = { "e5", "1e", "1e+", ".", "1.2.3", "inf", "nan", "1,5",
+        "0x1p3", NULL };
+    /* halfway between two doubles, only pushed up by the very last digit */
+    static char halfway[1024];
+    size_t i;
+
+    ls_args_init(&args);
+    ASSERT(ls_args_double(&args, &ratio, "r", "ratio", "Ratio", 0));
+    for (i = 0; values[i] != NULL; ++i) {
+        one[2] = values[i];
+        ASSERT(ls_args_parse(&args, 3, one));
+        ASSERT(ratio == strtod(values[i], NULL));
+    }
+    strcpy(halfway, "9007199254740993");
+    memset(halfway + 16, '0', 900);
+    strcpy(halfway + 916, "1e-901");
+    one[2] = halfway;
+    ASSERT(ls_args_parse(&args, 3, one));
+    ASSERT(ratio == 9007199254740994.0);
+    ASSERT(ratio == strtod(halfway, NULL));
+
+    for (i = 0; bad[i] != NULL; ++i) {
+        one[2] = bad[i];
+        ASSERT(!ls_args_parse(&args, 3, one));
+        ASSERT_EQ(args.error.code, LS_ARGS_ERR_NUMBER, "%d");
+    }
+    one[2] = "1e309";
+    ASSERT(!ls_args_parse(&args, 3, one));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_RANGE, "%d");
+    one[2] = "-1e309";
+    ASSERT(!ls_args_parse(&args, 3, one));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_RANGE, "%d");
+    ls_args_free(&args);
+    return 0;
+}
+
+/* Also built with a raised LS_ARGS_ERROR_MAX, see `make test-variants` */
+TEST_CASE(number_error_fits) {
+    static char long_opt[901];
+    static char value[2001];
+    int64_t n = 0;
+    ls_args args;
+    char* argv[] = { "./program", NULL, value, NULL };
+    char dashed[904];
+    const char* msg;
+
+    memset(long_opt, 'o', 900);
+    memset(value, '9', 2000);
+    value[0] = 'x';
+    sprintf(dashed, "--%s", long_opt);
+    argv[1] = dashed;
+    ls_args_init(&args);
+    ASSERT(ls_args_int64(&args, &n, NULL, long_opt, "Long", 0));
+    ASSERT(!ls_args_parse(&args, 3, argv));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_NUMBER, "%d");
+    msg = ls_args_error(&args);
+    ASSERT(strlen(msg) == LS_ARGS_ERROR_MAX - 1);
+    ASSERT(strncmp(msg, "Invalid number 'x99", 19) == 0);
+    ASSERT(strstr(msg, "' for '--oooo") != NULL);
+    ASSERT(msg[strlen(msg) - 1] == '\'');
+
+    value[0] = '9';
+    ASSERT(!ls_args_parse(&args, 3, argv));
+    ASSERT_EQ(args.error.code, LS_ARGS_ERR_RANGE, "%d");
+    msg = ls_args_error(&args);
+    ASSERT(strlen(msg) == LS_ARGS_ERROR_MAX - 1);
+    ASSERT(strstr(msg, "' out of range for '--oooo") != NULL);
+    ls_args_free(&args);
+    return 0;
+}
+
 TEST_MAIN
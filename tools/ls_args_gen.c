@@ -0,0 +1,724 @@
+/* ls_args_gen: generates a static ls_args spec with specialized matchers.
+ *
+ * Reads a declarative option table and writes C code, to be included in ONE
+ * source file, which defines:
+ *
+ * - `struct <prefix>_opts`, with one field per argument, and `<prefix>`, an
+ *   instance of it which receives the parsed values,
+ * - `<prefix>_args`, the static `ls_args_arg` array,
+ * - `<prefix>_match_long` and `<prefix>_match_short`, switch-based matchers
+ *   which compare the length of a long option first, then only the characters
+ *   which tell the candidates apart, and
+ * - `<prefix>_table`, the `ls_args_table` tying it all together.
+ *
+ * With LS_ARGS_GEN_REGISTER defined before the include, it also defines
+ * `<prefix>_register`, which registers the same spec the dynamic way. That is
+ * mostly useful for testing.
+ *
+ * Usage:
+ *
+ *     ls_args_gen -p example -o example_args.h example.opts
+ *
+ *     #include "example_args.h"
+ *     // ...
+ *     ls_args args;
+ *     ls_args_init(&args);
+ *     ls_args_use_table(&args, &example_table);
+ *     if (!ls_args_parse(&args, argc, argv)) { ... }
+ *     if (example.verbose) { ... }
+ *
+ * Input format, one argument per line, in registration order. Empty lines and
+ * lines starting with `#` are ignored, the help text or name is the rest of the
+ * line:
+ *
+ *     bool   <short|-> <long|-> <required|optional> [help]
+ *     string <short|-> <long|-> <required|optional> [help]
+ *     int64  <short|-> <long|-> <required|optional> [help]
+ *     uint64 <short|-> <long|-> <required|optional> [help]
+ *     double <short|-> <long|-> <required|optional> [help]
+ *     pos    <field> <required|optional> <name>
+ *     rest   <field> <required|optional> <name>
+ *
+ * For options, the field is named after the long option, with `-` turned
+ * into `_` and a `_` appended to C keywords (`--default` becomes `default_`),
+ * or after the short option if there's no long one. Options with the same
+ * field and type share it, like registering them with the same `val`.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ls_args.h"
+
+#define LINE_MAX_LEN 4096
+
+/* The kinds of options in the input, and the `LS_ARGS_*` initializers for
+ * them, indexed by ls_args_type. "rest" is only for positionals. */
+static const char* const kinds[]
+    = { "bool", "string", "rest", "int64", "uint64", "double" };
+static const char* const kind_macros[]
+    = { "BOOL", "STRING", "REST", "INT64", "UINT64", "DOUBLE" };
+
+typedef struct gen_arg {
+    ls_args_type type;
+    int is_pos;
+    int required;
+    char short_opt;
+    char* long_opt;
+    char* field;
+    /* help text for options, name for positionals, may be NULL */
+    char* help;
+    /* first argument with the same field, or itself */
+    size_t field_owner;
+} gen_arg;
+
+typedef struct gen {
+    const char* path;
+    const char* prefix;
+    FILE* out;
+    gen_arg* args;
+    size_t len;
+    size_t cap;
+    /* indices of the arguments which win the lookup for their long name,
+     * sorted by length */
+    size_t* longs;
+    size_t longs_len;
+} gen;
+
+static void die(const gen* g, size_t line, const char* msg) {
+    if (line > 0) {
+        fprintf(stderr, "%s:%lu: %s\n", g->path, (unsigned long)line, msg);
+    } else {
+        fprintf(stderr, "ls_args_gen: %s\n", msg);
+    }
+    exit(1);
+}
+
+static char* dup_str(const gen* g, const char* s, size_t len) {
+    char* res = malloc(len + 1);
+    if (res == NULL) {
+        die(g, 0, "out of memory");
+    }
+    memcpy(res, s, len);
+    res[len] = 0;
+    return res;
+}
+
+/* Splits off the next whitespace-separated word of `*s` */
+static char* next_word(const gen* g, char** s) {
+    char* begin = *s;
+    char* end;
+    while (isspace((unsigned char)*begin)) {
+        ++begin;
+    }
+    end = begin;
+    while (*end && !isspace((unsigned char)*end)) {
+        ++end;
+    }
+    *s = end;
+    if (begin == end) {
+        return NULL;
+    }
+    return dup_str(g, begin, (size_t)(end - begin));
+}
+
+/* The rest of the line, trimmed, or NULL if that's empty */
+static char* rest_of_line(const gen* g, char* s) {
+    size_t len;
+    while (isspace((unsigned char)*s)) {
+        ++s;
+    }
+    len = strlen(s);
+    while (len > 0 && isspace((unsigned char)s[len - 1])) {
+        --len;
+    }
+    return len > 0 ? dup_str(g, s, len) : NULL;
+}
+
+static int parse_mode(const gen* g, size_t line, const char* word) {
+    if (word != NULL && strcmp(word, "required") == 0) {
+        return 1;
+    }
+    if (word != NULL && strcmp(word, "optional") == 0) {
+        return 0;
+    }
+    die(g, line, "expected 'required' or 'optional'");
+    return 0;
+}
+
+/* Can't be field names. C89's, and `inline` and `restrict` from C99. */
+static const char* const keywords[] = { "auto", "break", "case", "char",
+    "const", "continue", "default", "do", "double", "else", "enum", "extern",
+    "float", "for", "goto", "if", "inline", "int", "long", "register",
+    "restrict", "return", "short", "signed", "sizeof", "static", "struct",
+    "switch", "typedef", "union", "unsigned", "void", "volatile", "while" };
+
+static int is_keyword(const char* s) {
+    size_t i;
+    for (i = 0; i < sizeof(keywords) / sizeof(*keywords); ++i) {
+        if (strcmp(s, keywords[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int is_identifier(const char* s) {
+    if (!isalpha((unsigned char)*s) && *s != '_') {
+        return 0;
+    }
+    while (*++s) {
+        if (!isalnum((unsigned char)*s) && *s != '_') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static gen_arg* push_arg(gen* g) {
+    if (g->len == g->cap) {
+        g->cap = g->cap ? g->cap * 2 : 64;
+        g->args = realloc(g->args, g->cap * sizeof(*g->args));
+        if (g->args == NULL) {
+            die(g, 0, "out of memory");
+        }
+    }
+    memset(&g->args[g->len], 0, sizeof(*g->args));
+    return &g->args[g->len++];
+}
+
+static void parse_option(gen* g, size_t line, gen_arg* arg, char* s) {
+    char* short_opt = next_word(g, &s);
+    char* long_opt = next_word(g, &s);
+    char* mode = next_word(g, &s);
+    char* p;
+    if (short_opt == NULL || long_opt == NULL) {
+        die(g, line, "expected a short and a long option, or '-'");
+    }
+    arg->required = parse_mode(g, line, mode);
+    arg->help = rest_of_line(g, s);
+    /* dashes are optional, like with `ls_args_bool` */
+    p = short_opt;
+    while (*p == '-' && p[1] != 0) {
+        ++p;
+    }
+    if (strcmp(short_opt, "-") != 0) {
+        if (*p == '-' || strlen(p) != 1) {
+            die(g, line, "a short option is a single character");
+        }
+        arg->short_opt = *p;
+    }
+    if (strcmp(long_opt, "-") != 0) {
+        p = long_opt;
+        while (*p == '-') {
+            ++p;
+        }
+        if (*p == 0) {
+            die(g, line, "empty long option");
+        }
+        arg->long_opt = dup_str(g, p, strlen(p));
+        /* room for the `_` a keyword gets */
+        arg->field = dup_str(g, p, strlen(p) + 1);
+        for (p = arg->field; *p; ++p) {
+            if (*p == '-') {
+                *p = '_';
+            }
+        }
+        if (is_keyword(arg->field)) {
+            strcat(arg->field, "_");
+        }
+    } else if (arg->short_opt != 0) {
+        arg->field = dup_str(g, &arg->short_opt, 1);
+    } else {
+        die(g, line, "an option needs a short or a long name");
+    }
+    if (!is_identifier(arg->field)) {
+        die(g, line, "the option name doesn't make a valid field name");
+    }
+    free(short_opt);
+    free(long_opt);
+    free(mode);
+}
+
+static void parse_positional(gen* g, size_t line, gen_arg* arg, char* s) {
+    char* mode;
+    size_t i;
+    for (i = 0; i + 1 < g->len; ++i) {
+        if (g->args[i].type == LS_ARGS_TYPE_REST) {
+            die(g, line, "no positional can follow a 'rest' positional");
+        }
+    }
+    arg->is_pos = 1;
+    arg->field = next_word(g, &s);
+    if (arg->field == NULL || !is_identifier(arg->field)) {
+        die(g, line, "expected a field name");
+    }
+    if (is_keyword(arg->field)) {
+        die(g, line, "the field name is a C keyword");
+    }
+    mode = next_word(g, &s);
+    arg->required = parse_mode(g, line, mode);
+    arg->help = rest_of_line(g, s);
+    if (arg->help == NULL) {
+        die(g, line, "expected a name");
+    }
+    free(mode);
+}
+
+static void read_spec(gen* g) {
+    char buf[LINE_MAX_LEN];
+    size_t line = 0;
+    FILE* in = fopen(g->path, "r");
+    if (in == NULL) {
+        perror(g->path);
+        exit(1);
+    }
+    while (fgets(buf, sizeof(buf), in) != NULL) {
+        char* s = buf;
+        char* kind;
+        gen_arg* arg;
+        ++line;
+        if (strchr(buf, '\n') == NULL && !feof(in)) {
+            die(g, line, "line too long");
+        }
+        kind = next_word(g, &s);
+        if (kind == NULL || kind[0] == '#') {
+            free(kind);
+            continue;
+        }
+        arg = push_arg(g);
+        if (strcmp(kind, "pos") == 0 || strcmp(kind, "rest") == 0) {
+            arg->type = kind[0] == 'p' ? LS_ARGS_TYPE_STRING
+                                       : LS_ARGS_TYPE_REST;
+            parse_positional(g, line, arg, s);
+        } else {
+            size_t t;
+            for (t = 0; t < sizeof(kinds) / sizeof(*kinds); ++t) {
+                if (t != LS_ARGS_TYPE_REST && strcmp(kind, kinds[t]) == 0) {
+                    break;
+                }
+            }
+            if (t == sizeof(kinds) / sizeof(*kinds)) {
+                die(g, line,
+                    "expected 'bool', 'string', 'int64', 'uint64', 'double', "
+                    "'pos' or 'rest'");
+            }
+            arg->type = (ls_args_type)t;
+            parse_option(g, line, arg, s);
+        }
+        free(kind);
+    }
+    fclose(in);
+    if (g->len == 0) {
+        die(g, 0, "the spec is empty");
+    }
+}
+
+static const char* c_type(const gen_arg* arg) {
+    switch (arg->type) {
+    case LS_ARGS_TYPE_BOOL:
+        return "int";
+    case LS_ARGS_TYPE_STRING:
+        return "const char*";
+    case LS_ARGS_TYPE_REST:
+        return "ls_args_rest";
+    case LS_ARGS_TYPE_INT64:
+        return "int64_t";
+    case LS_ARGS_TYPE_UINT64:
+        return "uint64_t";
+    case LS_ARGS_TYPE_DOUBLE:
+        return "double";
+    }
+    return NULL;
+}
+
+/* Shares fields between arguments with the same name, and checks that they
+ * have the same type. Quadratic, but only runs once per build. */
+static void assign_fields(gen* g) {
+    size_t i, k;
+    for (i = 0; i < g->len; ++i) {
+        g->args[i].field_owner = i;
+        for (k = 0; k < i; ++k) {
+            if (strcmp(g->args[k].field, g->args[i].field) == 0) {
+                if (g->args[k].type != g->args[i].type) {
+                    fprintf(stderr, "%s: field '%s' is used with two types\n",
+                        g->path, g->args[i].field);
+                    exit(1);
+                }
+                g->args[i].field_owner = g->args[k].field_owner;
+                break;
+            }
+        }
+    }
+}
+
+/* qsort has no context argument */
+static const gen* sort_gen;
+
+static int by_length(const void* lhs, const void* rhs) {
+    const char* a = sort_gen->args[*(const size_t*)lhs].long_opt;
+    const char* b = sort_gen->args[*(const size_t*)rhs].long_opt;
+    size_t a_len = strlen(a);
+    size_t b_len = strlen(b);
+    if (a_len != b_len) {
+        return a_len < b_len ? -1 : 1;
+    }
+    return strcmp(a, b);
+}
+
+/* Collects the long options which can be matched, dropping later duplicates,
+ * since the first registration wins. */
+static void collect_longs(gen* g) {
+    size_t i, k;
+    g->longs = malloc(g->len * sizeof(*g->longs));
+    if (g->longs == NULL) {
+        die(g, 0, "out of memory");
+    }
+    for (i = 0; i < g->len; ++i) {
+        if (!g->args[i].is_pos && g->args[i].long_opt != NULL) {
+            g->longs[g->longs_len++] = i;
+        }
+    }
+    sort_gen = g;
+    qsort(g->longs, g->longs_len, sizeof(*g->longs), by_length);
+    /* equal names are adjacent now, keep the lowest index of each */
+    for (i = 0, k = 0; i < g->longs_len; ++i) {
+        if (k > 0
+            && strcmp(g->args[g->longs[k - 1]].long_opt,
+                   g->args[g->longs[i]].long_opt)
+                == 0) {
+            if (g->longs[i] < g->longs[k - 1]) {
+                g->longs[k - 1] = g->longs[i];
+            }
+            continue;
+        }
+        g->longs[k++] = g->longs[i];
+    }
+    g->longs_len = k;
+}
+
+static void put_string(FILE* out, const char* s) {
+    if (s == NULL) {
+        fputs("NULL", out);
+        return;
+    }
+    fputc('"', out);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c == '?') {
+            /* no trigraphs */
+            fputs("\\?", out);
+        } else if (isprint(c)) {
+            fputc(c, out);
+        } else {
+            fprintf(out, "\\%03o", c);
+        }
+    }
+    fputc('"', out);
+}
+
+static void put_char(FILE* out, unsigned char c) {
+    if (isalnum(c) || c == '-' || c == '_' || c == '.') {
+        fprintf(out, "'%c'", c);
+    } else {
+        fprintf(out, "%u", c);
+    }
+}
+
+static void indent(FILE* out, int depth) {
+    int i;
+    for (i = 0; i < depth; ++i) {
+        fputs("    ", out);
+    }
+}
+
+/* Emits the decision tree for `longs[first..last)`, which all have length
+ * `len`: switch on the character which splits them into the most groups, until
+ * one candidate remains, which is then compared in full. */
+static void emit_long_tree(
+    const gen* g, size_t* longs, size_t first, size_t last, size_t len,
+    int depth) {
+    FILE* out = g->out;
+    size_t best = 0, best_groups = 0, pos, i;
+    if (last - first == 1) {
+        const char* name = g->args[longs[first]].long_opt;
+        indent(out, depth);
+        fputs("return memcmp(s, ", out);
+        put_string(out, name);
+        fprintf(out, ", %lu) == 0 ? %lu : 0;\n", (unsigned long)len,
+            (unsigned long)longs[first] + 1);
+        return;
+    }
+    for (pos = 0; pos < len; ++pos) {
+        unsigned char seen[256];
+        size_t groups = 0;
+        memset(seen, 0, sizeof(seen));
+        for (i = first; i < last; ++i) {
+            unsigned char c = (unsigned char)g->args[longs[i]].long_opt[pos];
+            if (!seen[c]) {
+                seen[c] = 1;
+                ++groups;
+            }
+        }
+        if (groups > best_groups) {
+            best = pos;
+            best_groups = groups;
+        }
+    }
+    /* distinct names of equal length always differ somewhere */
+    indent(out, depth);
+    fprintf(out, "switch ((unsigned char)s[%lu]) {\n", (unsigned long)best);
+    while (first < last) {
+        unsigned char c = (unsigned char)g->args[longs[first]].long_opt[best];
+        size_t end = first;
+        /* stable partition of the rest by the character at `best` */
+        for (i = first; i < last; ++i) {
+            if ((unsigned char)g->args[longs[i]].long_opt[best] == c) {
+                size_t tmp = longs[i];
+                memmove(&longs[end + 1], &longs[end],
+                    (i - end) * sizeof(*longs));
+                longs[end++] = tmp;
+            }
+        }
+        indent(out, depth);
+        fputs("case ", out);
+        put_char(out, c);
+        fputs(":\n", out);
+        emit_long_tree(g, longs, first, end, len, depth + 1);
+        first = end;
+    }
+    indent(out, depth);
+    fputs("}\n", out);
+    indent(out, depth);
+    fputs("return 0;\n", out);
+}
+
+static void emit_match_long(gen* g) {
+    FILE* out = g->out;
+    size_t first = 0;
+    fprintf(out,
+        "static size_t %s_match_long(const char* s, size_t len) {\n",
+        g->prefix);
+    if (g->longs_len == 0) {
+        fputs("    (void)s;\n    (void)len;\n    return 0;\n}\n\n", out);
+        return;
+    }
+    fputs("    switch (len) {\n", out);
+    while (first < g->longs_len) {
+        size_t len = strlen(g->args[g->longs[first]].long_opt);
+        size_t last = first;
+        while (last < g->longs_len
+            && strlen(g->args[g->longs[last]].long_opt) == len) {
+            ++last;
+        }
+        fprintf(out, "    case %lu:\n", (unsigned long)len);
+        emit_long_tree(g, g->longs, first, last, len, 2);
+        first = last;
+    }
+    fputs("    }\n    return 0;\n}\n\n", out);
+}
+
+static void emit_match_short(const gen* g) {
+    FILE* out = g->out;
+    int seen[256];
+    size_t i;
+    int any = 0;
+    memset(seen, 0, sizeof(seen));
+    fprintf(out, "static size_t %s_match_short(unsigned char c) {\n",
+        g->prefix);
+    for (i = 0; i < g->len; ++i) {
+        unsigned char c = (unsigned char)g->args[i].short_opt;
+        if (g->args[i].is_pos || c == 0 || seen[c]) {
+            continue;
+        }
+        if (!any) {
+            fputs("    switch (c) {\n", out);
+            any = 1;
+        }
+        seen[c] = 1;
+        fputs("    case ", out);
+        put_char(out, c);
+        fprintf(out, ":\n        return %lu;\n", (unsigned long)i + 1);
+    }
+    if (any) {
+        fputs("    }\n", out);
+    } else {
+        fputs("    (void)c;\n", out);
+    }
+    fputs("    return 0;\n}\n\n", out);
+}
+
+static void emit_struct(const gen* g) {
+    FILE* out = g->out;
+    size_t i;
+    fprintf(out, "struct %s_opts {\n", g->prefix);
+    for (i = 0; i < g->len; ++i) {
+        if (g->args[i].field_owner == i) {
+            fprintf(out, "    %s %s;\n", c_type(&g->args[i]),
+                g->args[i].field);
+        }
+    }
+    fprintf(out, "};\n\n/* receives the values parsed with %s_table */\n",
+        g->prefix);
+    fprintf(out, "static struct %s_opts %s;\n\n", g->prefix, g->prefix);
+}
+
+static const char* mode_name(int required) {
+    return required ? "LS_ARGS_REQUIRED" : "LS_ARGS_OPTIONAL";
+}
+
+static void emit_args(const gen* g) {
+    FILE* out = g->out;
+    size_t i;
+    fprintf(out, "static const ls_args_arg %s_args[%lu] = {\n", g->prefix,
+        (unsigned long)g->len);
+    for (i = 0; i < g->len; ++i) {
+        const gen_arg* arg = &g->args[i];
+        const char* field = g->args[arg->field_owner].field;
+        char short_opt[2];
+        short_opt[0] = arg->short_opt;
+        short_opt[1] = 0;
+        if (arg->is_pos) {
+            fprintf(out, "    LS_ARGS_POS_%s(&%s.%s, ",
+                arg->type == LS_ARGS_TYPE_REST ? "REST" : "STRING", g->prefix,
+                field);
+        } else {
+            fprintf(out, "    LS_ARGS_%s(&%s.%s, ", kind_macros[arg->type],
+                g->prefix, field);
+            put_string(out, arg->short_opt != 0 ? short_opt : NULL);
+            fputs(", ", out);
+            put_string(out, arg->long_opt);
+            fputs(",\n        ", out);
+        }
+        put_string(out, arg->help);
+        fprintf(out, ", %s),\n", mode_name(arg->required));
+    }
+    fputs("};\n\n", out);
+}
+
+static void emit_table(gen* g) {
+    FILE* out = g->out;
+    size_t i, pos_len = 0, required = 0;
+    fprintf(out, "static const size_t %s_pos_index[] = {", g->prefix);
+    for (i = 0; i < g->len; ++i) {
+        if (g->args[i].is_pos) {
+            fprintf(out, "%s%lu", pos_len ? ", " : " ", (unsigned long)i);
+            ++pos_len;
+        }
+        required += g->args[i].required;
+    }
+    /* C89 has no empty arrays */
+    fputs(pos_len ? " };\n\n" : " 0 };\n\n", out);
+    emit_match_long(g);
+    emit_match_short(g);
+    fprintf(out, "static const ls_args_table %s_table = { %s_args, %lu,\n",
+        g->prefix, g->prefix, (unsigned long)g->len);
+    fprintf(out, "    %s_pos_index, %lu, %lu, %s_match_long,\n", g->prefix,
+        (unsigned long)pos_len, (unsigned long)required, g->prefix);
+    fprintf(out, "    %s_match_short };\n", g->prefix);
+}
+
+static void emit_register(const gen* g) {
+    FILE* out = g->out;
+    size_t i;
+    char short_opt[2];
+    fprintf(out,
+        "\n#ifdef LS_ARGS_GEN_REGISTER\n"
+        "/* registers the same spec as %s_table, with ls_args_bool and friends "
+        "*/\nstatic int %s_register(ls_args* a) {\n",
+        g->prefix, g->prefix);
+    for (i = 0; i < g->len; ++i) {
+        const gen_arg* arg = &g->args[i];
+        const char* field = g->args[arg->field_owner].field;
+        short_opt[0] = arg->short_opt;
+        short_opt[1] = 0;
+        if (arg->is_pos) {
+            fprintf(out, "    if (!ls_args_pos_%s(a, &%s.%s, ",
+                arg->type == LS_ARGS_TYPE_REST ? "rest" : "string", g->prefix,
+                field);
+            put_string(out, arg->help);
+        } else {
+            fprintf(out, "    if (!ls_args_%s(a, &%s.%s, ", kinds[arg->type],
+                g->prefix, field);
+            put_string(out, arg->short_opt != 0 ? short_opt : NULL);
+            fputs(", ", out);
+            put_string(out, arg->long_opt);
+            fputs(",\n            ", out);
+            put_string(out, arg->help);
+        }
+        fprintf(out, ", %s))\n        return 0;\n", mode_name(arg->required));
+    }
+    fputs("    return 1;\n}\n#endif\n", out);
+}
+
+static void free_gen(gen* g) {
+    size_t i;
+    for (i = 0; i < g->len; ++i) {
+        free(g->args[i].long_opt);
+        free(g->args[i].field);
+        free(g->args[i].help);
+    }
+    free(g->args);
+    free(g->longs);
+}
+
+int main(int argc, char** argv) {
+    ls_args args;
+    gen g;
+    const char* out_path = NULL;
+    int help = 0;
+
+    memset(&g, 0, sizeof(g));
+    ls_args_init(&args);
+    args.help_description = "Generates a static ls_args spec with specialized "
+                            "matchers from an option table.";
+    ls_args_bool(&args, &help, "h", "help", "Prints help", 0);
+    ls_args_string(&args, &g.prefix, "p", "prefix",
+        "Prefix of the generated names", LS_ARGS_REQUIRED);
+    ls_args_string(
+        &args, &out_path, "o", "out", "Output file, default stdout", 0);
+    ls_args_pos_string(&args, &g.path, "option table", LS_ARGS_REQUIRED);
+    if (!ls_args_parse(&args, argc, argv)) {
+        if (help) {
+            puts(ls_args_help(&args));
+            ls_args_free(&args);
+            return 0;
+        }
+        fprintf(stderr, "Error: %s\n", ls_args_error(&args));
+        ls_args_free(&args);
+        return 1;
+    }
+    if (!is_identifier(g.prefix)) {
+        die(&g, 0, "the prefix must be a valid identifier");
+    }
+
+    read_spec(&g);
+    assign_fields(&g);
+    collect_longs(&g);
+
+    g.out = out_path != NULL ? fopen(out_path, "w") : stdout;
+    if (g.out == NULL) {
+        perror(out_path);
+        return 1;
+    }
+    fprintf(g.out,
+        "/* Generated by ls_args_gen from %s, do not edit.\n"
+        " * Include in exactly one source file. */\n"
+        "#include <string.h>\n\n"
+        "#include \"ls_args.h\"\n\n",
+        g.path);
+    emit_struct(&g);
+    emit_args(&g);
+    emit_table(&g);
+    emit_register(&g);
+    if (ferror(g.out) || (out_path != NULL && fclose(g.out) != 0)) {
+        perror(out_path != NULL ? out_path : "stdout");
+        return 1;
+    }
+    free_gen(&g);
+    ls_args_free(&args);
+    return 0;
+}